@@ -0,0 +1,409 @@
+/*
+ * Benchmarks for jq's parser, printer, interpreter and builtins.
+ *
+ * Usage: jq_bench [NAME...]
+ *
+ * Generates synthetic corpora from a fixed seed, so that every run and
+ * every build sees the same input, times each benchmark whose name
+ * contains one of the NAMEs (all of them by default), and writes the
+ * results to standard output as JSON for benchmarks/compare.
+ *
+ * BENCH_SCALE multiplies the size of the corpora (default 1),
+ * BENCH_MIN_MS is how long each round of a benchmark runs for at least
+ * (default 100) and BENCH_ROUNDS how many rounds are timed (default 5).
+ * The fastest round is reported, as the least disturbed by the rest of
+ * the system.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jv.h"
+#include "jq.h"
+#include "jv_alloc.h"
+#include "util.h"
+
+static double scale = 1;
+static double min_ms = 100;
+static int rounds = 5;
+
+/* xorshift64*, for corpora that don't depend on the C library */
+static uint64_t rng_state;
+
+static void rng_seed(uint64_t seed) {
+  rng_state = seed;
+}
+
+static uint32_t rng(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (rng_state * 2685821657736338717ULL) >> 32;
+}
+
+static int scaled(int n) {
+  return n * scale > 1 ? (int)(n * scale) : 1;
+}
+
+/*
+ * Corpora
+ *
+ * Each corpus is an array of documents, and the same documents as text,
+ * one per line.
+ */
+
+struct corpus {
+  const char *name;
+  jv docs;
+  jv text;
+};
+
+static jv gen_logs(void) {
+  static const char *levels[] = {"debug", "info", "info", "info", "warn", "error"};
+  static const char *paths[] = {"api", "v1", "v2", "users", "orders", "items", "search", "static"};
+  static const int statuses[] = {200, 200, 200, 201, 204, 301, 304, 400, 404, 500, 503};
+  jv docs = jv_array();
+  int n = scaled(20000);
+  for (int i = 0; i < n; i++) {
+    jv path = jv_string("");
+    for (int j = 1 + rng() % 4; j > 0; j--) {
+      path = jv_string_append_str(path, "/");
+      path = jv_string_append_str(path, paths[rng() % 8]);
+    }
+    jv tags = jv_array();
+    for (int j = rng() % 4; j > 0; j--)
+      tags = jv_array_append(tags, jv_string_fmt("tag%u", rng() % 50));
+    uint32_t user = rng() % 1000;
+    jv rec = JV_OBJECT(jv_string("ts"), jv_number(1700000000 + i * 7 + rng() % 7),
+                       jv_string("level"), jv_string(levels[rng() % 6]),
+                       jv_string("user"), JV_OBJECT(jv_string("id"), jv_number(user),
+                                                    jv_string("name"), jv_string_fmt("user%u", user)),
+                       jv_string("path"), path,
+                       jv_string("status"), jv_number(statuses[rng() % 11]),
+                       jv_string("latency_ms"), jv_number((rng() % 100000) / 100.0),
+                       jv_string("tags"), tags);
+    if (rng() % 10 == 0)
+      rec = jv_object_set(rec, jv_string("message"),
+                          jv_string_fmt("request \"%u\" failed:\n\tretrying", rng()));
+    docs = jv_array_append(docs, rec);
+  }
+  return docs;
+}
+
+static jv gen_deep(void) {
+  jv docs = jv_array();
+  int n = scaled(200);
+  for (int i = 0; i < n; i++) {
+    jv v = jv_number(i);
+    for (int d = 0; d < 500; d++) {
+      if (d % 2)
+        v = JV_ARRAY(v, jv_number(d));
+      else
+        v = JV_OBJECT(jv_string("k"), v, jv_string("d"), jv_number(d));
+    }
+    docs = jv_array_append(docs, v);
+  }
+  return docs;
+}
+
+static jv gen_wide(void) {
+  jv docs = jv_array();
+  int n = scaled(20);
+  for (int i = 0; i < n; i++) {
+    jv obj = jv_object();
+    for (int k = 0; k < 5000; k++) {
+      jv v;
+      switch (rng() % 4) {
+      case 0: v = jv_number(rng()); break;
+      case 1: v = jv_string_fmt("value%u", rng() % 10000); break;
+      case 2: v = jv_bool(rng() % 2); break;
+      default: v = jv_null(); break;
+      }
+      obj = jv_object_set(obj, jv_string_fmt("key%05d_%u", k, rng() % 100), v);
+    }
+    docs = jv_array_append(docs, obj);
+  }
+  return docs;
+}
+
+static jv gen_numbers(void) {
+  jv nums = jv_array();
+  int n = scaled(200000);
+  for (int i = 0; i < n; i++) {
+    if (rng() % 2)
+      nums = jv_array_append(nums, jv_number((int32_t)rng()));
+    else
+      nums = jv_array_append(nums, jv_number((rng() - 2147483648.0) / (1 + rng() % 100000)));
+  }
+  return JV_ARRAY(nums);
+}
+
+static jv gen_strings(void) {
+  static const char *pieces[] = {"lorem ", "ipsum ", "\"quoted\" ", "tab\t", "line\n",
+                                 "caf\xc3\xa9 ", "\xe6\x97\xa5\xe6\x9c\xac ", "\xf0\x9f\x98\x80 ",
+                                 "back\\slash ", "\x01"};
+  jv docs = jv_array();
+  int n = scaled(64);
+  for (int i = 0; i < n; i++) {
+    jv s = jv_string("");
+    while (jv_string_length_bytes(jv_copy(s)) < 16384)
+      s = jv_string_append_str(s, pieces[rng() % 10]);
+    docs = jv_array_append(docs, s);
+  }
+  return docs;
+}
+
+static struct corpus make_corpus(const char *name, jv docs) {
+  jv text = jv_string("");
+  jv_array_foreach(docs, i, doc) {
+    text = jv_string_concat(text, jv_dump_string(doc, 0));
+    text = jv_string_append_str(text, "\n");
+  }
+  return (struct corpus){name, docs, text};
+}
+
+/*
+ * Timing
+ */
+
+struct bench {
+  char name[64];
+  void (*run)(struct bench *);
+  int flags;
+  double bytes;
+  double records;
+  /* What the benchmark works on */
+  struct corpus *corpus;
+  jq_state *jq;
+  jv input;
+};
+
+static jv results;
+
+static double time_runs(struct bench *b, long n) {
+  double start = jq_wall_ms();
+  for (long i = 0; i < n; i++)
+    b->run(b);
+  return jq_wall_ms() - start;
+}
+
+static void report(struct bench *b) {
+  // Count the allocations of one run on its own, as that slows it
+  size_t allocs = jv_mem_alloc_count();
+  uint64_t bytes = jv_mem_stats_get()[JV_MEM_TOTAL].alloc_bytes;
+  jv_mem_stats_enable(1);
+  b->run(b);
+  jv_mem_stats_enable(0);
+  allocs = jv_mem_alloc_count() - allocs;
+  bytes = jv_mem_stats_get()[JV_MEM_TOTAL].alloc_bytes - bytes;
+
+  long n = 1;
+  double ms;
+  while ((ms = time_runs(b, n)) < min_ms && n < (1L << 30))
+    n = ms > 0 && ms < min_ms / 2 ? n * 2 * (long)(min_ms / ms / 2 + 1) : n * 2;
+  double best = ms / n;
+  for (int r = 1; r < rounds; r++) {
+    ms = time_runs(b, n) / n;
+    if (ms < best)
+      best = ms;
+  }
+
+  fprintf(stderr, "%-24s %10.3f ms %9.2f MB/s %12.0f records/s %10lu allocs\n",
+          b->name, best, b->bytes / best / 1e3, b->records / best * 1e3,
+          (unsigned long)allocs);
+  results = jv_array_append(results,
+                            JV_OBJECT(jv_string("name"), jv_string(b->name),
+                                      jv_string("iterations"), jv_number(n * rounds),
+                                      jv_string("ms"), jv_number(best),
+                                      jv_string("bytes"), jv_number(b->bytes),
+                                      jv_string("records"), jv_number(b->records),
+                                      jv_string("mb_per_s"), jv_number(b->bytes / best / 1e3),
+                                      jv_string("records_per_s"), jv_number(b->records / best * 1e3),
+                                      jv_string("allocs"), jv_number(allocs),
+                                      jv_string("alloc_bytes"), jv_number(bytes)));
+}
+
+static void skip(struct bench *b, jv why) {
+  fprintf(stderr, "%-24s skipped: %s\n", b->name, jv_string_value(why));
+  results = jv_array_append(results,
+                            JV_OBJECT(jv_string("name"), jv_string(b->name),
+                                      jv_string("skipped"), why));
+}
+
+/*
+ * Benchmarks
+ */
+
+static void run_parse(struct bench *b) {
+  jv_parser *p = jv_parser_new(b->flags);
+  jv text = b->corpus->text;
+  jv_parser_set_buf(p, jv_string_value(text), jv_string_length_bytes(jv_copy(text)), 0);
+  jv v;
+  while (jv_is_valid(v = jv_parser_next(p)))
+    jv_free(v);
+  jv_free(v);
+  jv_parser_free(p);
+}
+
+static void run_parse_events(struct bench *b) {
+  jv_parser *p = jv_parser_new(JV_PARSE_EVENTS);
+  jv text = b->corpus->text;
+  jv_parser_set_buf(p, jv_string_value(text), jv_string_length_bytes(jv_copy(text)), 0);
+  jv v;
+  while (jv_parser_next_event(p, &v) > JV_PARSE_EVENT_ERROR)
+    jv_free(v);
+  jv_free(v);
+  jv_parser_free(p);
+}
+
+static void run_dump(struct bench *b) {
+  jv_array_foreach(b->corpus->docs, i, doc)
+    jv_free(jv_dump_string(doc, 0));
+}
+
+static void run_filter(struct bench *b) {
+  jv_array_foreach(b->input, i, in) {
+    jq_start(b->jq, in, 0);
+    jv out;
+    while (jv_is_valid(out = jq_next(b->jq)))
+      jv_free(out);
+    jv_free(out);
+  }
+}
+
+static void run_sort(struct bench *b) {
+  jv_array_foreach(b->input, i, arr)
+    jv_free(jv_sort(arr, jv_copy(arr)));
+}
+
+static int wanted(const char *name, int argc, char *argv[]) {
+  if (argc < 2)
+    return 1;
+  for (int i = 1; i < argc; i++)
+    if (strstr(name, argv[i]))
+      return 1;
+  return 0;
+}
+
+/* Runs filter once over each of the inputs, or over all of them at once */
+static void bench_filter(struct corpus *c, const char *name, const char *filter,
+                         int slurp, int argc, char *argv[]) {
+  struct bench b = {0};
+  snprintf(b.name, sizeof(b.name), "filter/%s", name);
+  if (!wanted(b.name, argc, argv))
+    return;
+  b.run = run_filter;
+  b.bytes = jv_string_length_bytes(jv_copy(c->text));
+  b.records = jv_array_length(jv_copy(c->docs));
+  b.input = slurp ? JV_ARRAY(jv_copy(c->docs)) : jv_copy(c->docs);
+  b.jq = jq_init();
+  if (!b.jq || !jq_compile(b.jq, filter)) {
+    skip(&b, jv_string_fmt("%s doesn't compile", filter));
+  } else {
+    // Some builtins are optional, such as the regular expression ones
+    jq_start(b.jq, jv_array_get(jv_copy(b.input), 0), 0);
+    jv out;
+    while (jv_is_valid(out = jq_next(b.jq)))
+      jv_free(out);
+    if (jv_invalid_has_msg(jv_copy(out))) {
+      skip(&b, jv_invalid_get_msg(out));
+    } else {
+      jv_free(out);
+      report(&b);
+    }
+  }
+  jq_teardown(&b.jq);
+  jv_free(b.input);
+}
+
+int main(int argc, char *argv[]) {
+  if (getenv("BENCH_SCALE") && atof(getenv("BENCH_SCALE")) > 0)
+    scale = atof(getenv("BENCH_SCALE"));
+  if (getenv("BENCH_MIN_MS") && atof(getenv("BENCH_MIN_MS")) > 0)
+    min_ms = atof(getenv("BENCH_MIN_MS"));
+  if (getenv("BENCH_ROUNDS") && atoi(getenv("BENCH_ROUNDS")) > 0)
+    rounds = atoi(getenv("BENCH_ROUNDS"));
+
+  rng_seed(0x6a71626e6368ULL);
+  struct corpus corpora[] = {
+    make_corpus("logs", gen_logs()),
+    make_corpus("deep", gen_deep()),
+    make_corpus("wide", gen_wide()),
+    make_corpus("numbers", gen_numbers()),
+    make_corpus("strings", gen_strings()),
+  };
+  int ncorpora = sizeof(corpora) / sizeof(corpora[0]);
+  results = jv_array();
+
+  for (int i = 0; i < ncorpora; i++) {
+    struct corpus *c = &corpora[i];
+    struct bench b = {0};
+    b.corpus = c;
+    b.bytes = jv_string_length_bytes(jv_copy(c->text));
+    b.records = jv_array_length(jv_copy(c->docs));
+
+    snprintf(b.name, sizeof(b.name), "parse/%s", c->name);
+    b.run = run_parse;
+    if (wanted(b.name, argc, argv))
+      report(&b);
+
+    snprintf(b.name, sizeof(b.name), "stream/%s", c->name);
+    b.flags = JV_PARSE_STREAMING;
+    if (wanted(b.name, argc, argv))
+      report(&b);
+    b.flags = 0;
+
+    snprintf(b.name, sizeof(b.name), "events/%s", c->name);
+    b.run = run_parse_events;
+    if (wanted(b.name, argc, argv))
+      report(&b);
+
+    snprintf(b.name, sizeof(b.name), "dump/%s", c->name);
+    b.run = run_dump;
+    if (wanted(b.name, argc, argv))
+      report(&b);
+  }
+
+  struct corpus *logs = &corpora[0];
+  bench_filter(logs, ".field", ".user.name", 0, argc, argv);
+  bench_filter(logs, "select", "select(.status >= 500)", 0, argc, argv);
+  bench_filter(logs, "map", ".tags | map(. + \"!\")", 0, argc, argv);
+  bench_filter(logs, "to_entries", "to_entries", 0, argc, argv);
+  bench_filter(logs, "gsub", ".path | gsub(\"/\"; \".\")", 0, argc, argv);
+  bench_filter(logs, "tostream", "fromstream(tostream)", 0, argc, argv);
+  bench_filter(logs, "paths", "[paths(type == \"number\")] | length", 0, argc, argv);
+  bench_filter(logs, "walk", "walk(if type == \"object\" then del(.message) else . end)", 0, argc, argv);
+  bench_filter(logs, "walk_arrays", "[paths] | walk(.)", 0, argc, argv);
+  bench_filter(logs, "format", "tojson | @html, @uri, (@base64 | ., @base64d)", 0, argc, argv);
+  bench_filter(logs, "group_by", "group_by(.level) | map(length)", 1, argc, argv);
+  bench_filter(logs, "reduce", "reduce .[] as $r ({}; .[$r.level] += $r.latency_ms)", 1, argc, argv);
+
+  struct bench b = {0};
+  b.run = run_sort;
+  snprintf(b.name, sizeof(b.name), "sort/numbers");
+  b.input = jv_copy(corpora[3].docs);
+  b.bytes = jv_string_length_bytes(jv_copy(corpora[3].text));
+  b.records = jv_array_length(jv_array_get(jv_copy(b.input), 0));
+  if (wanted(b.name, argc, argv))
+    report(&b);
+  jv_free(b.input);
+
+  snprintf(b.name, sizeof(b.name), "sort/records");
+  b.input = JV_ARRAY(jv_copy(logs->docs));
+  b.bytes = jv_string_length_bytes(jv_copy(logs->text));
+  b.records = jv_array_length(jv_copy(logs->docs));
+  if (wanted(b.name, argc, argv))
+    report(&b);
+  jv_free(b.input);
+
+  jv_dumpf(JV_OBJECT(jv_string("scale"), jv_number(scale),
+                     jv_string("benchmarks"), results),
+           stdout, JV_PRINT_PRETTY | JV_PRINT_SPACE1);
+  printf("\n");
+
+  for (int i = 0; i < ncorpora; i++) {
+    jv_free(corpora[i].docs);
+    jv_free(corpora[i].text);
+  }
+  return 0;
+}
@@ -588,27 +588,54 @@ static jv escape_string(jv input, const char* escapings) {
 
   assert(jv_get_kind(input) == JV_KIND_STRING);
   const char* lookup[128] = {0};
+  unsigned char lookup_len[128] = {0};
   const char* p = escapings;
   lookup[0] = "\\0";
+  lookup_len[0] = 2;
   while (*p) {
     lookup[(int)*p] = p+1;
+    lookup_len[(int)*p] = strlen(p+1);
     p++;
     p += strlen(p);
     p++;
   }
 
-  jv ret = jv_string("");
-  const char* i = jv_string_value(input);
-  const char* end = i + jv_string_length_bytes(jv_copy(input));
-  const char* cstart;
-  int c = 0;
-  while ((i = jvp_utf8_next((cstart = i), end, &c))) {
-    if (c < 128 && lookup[c]) {
-      ret = jv_string_append_str(ret, lookup[c]);
-    } else {
-      ret = jv_string_append_buf(ret, cstart, i - cstart);
+  // The input is valid UTF-8, so ASCII bytes never occur inside a
+  // multibyte sequence and the string can be scanned bytewise.  Size
+  // the output exactly, and hand back the input if nothing needs
+  // escaping.
+  const unsigned char* s = (const unsigned char*)jv_string_value(input);
+  int len = jv_string_length_bytes(jv_copy(input));
+  size_t out_len = len;
+  int escapes = 0;
+  for (int i = 0; i < len; i++) {
+    if (s[i] < 128 && lookup[s[i]]) {
+      out_len += lookup_len[s[i]] - 1;
+      escapes++;
+    }
+  }
+  if (escapes == 0)
+    return input;
+  if (out_len >= INT_MAX) {
+    jv_free(input);
+    return jv_invalid_with_msg(jv_string("String too long"));
+  }
+
+  char* result = jv_mem_alloc(out_len + 1);
+  char* out = result;
+  int run = 0;
+  for (int i = 0; i < len; i++) {
+    if (s[i] < 128 && lookup[s[i]]) {
+      memcpy(out, s + run, i - run);
+      out += i - run;
+      memcpy(out, lookup[s[i]], lookup_len[s[i]]);
+      out += lookup_len[s[i]];
+      run = i + 1;
     }
   }
+  memcpy(out, s + run, len - run);
+  jv ret = jv_string_sized(result, out_len);
+  free(result);
   jv_free(input);
   return ret;
 
@@ -684,21 +711,34 @@ static jv f_format(jq_state *jq, jv input, jv fmt) {
   } else if (!strcmp(fmt_s, "uri")) {
     jv_free(fmt);
     input = f_tostring(jq, input);
-    const char* s = jv_string_value(input);
+    const unsigned char* s = (const unsigned char*)jv_string_value(input);
     int len = jv_string_length_bytes(jv_copy(input));
-    char *result = jv_mem_alloc((size_t)len * 3 + 1);
-    uint32_t ri = 0;
+    size_t escapes = 0;
+    for (int i = 0; i < len; i++)
+      escapes += !(s[i] < 128 && URI_UNRESERVED[s[i]]);
+    if (escapes == 0)
+      return input;
+    size_t out_len = (size_t)len + escapes * 2;
+    if (out_len >= INT_MAX) {
+      jv_free(input);
+      return jv_invalid_with_msg(jv_string("String too long"));
+    }
+    char *result = jv_mem_alloc(out_len + 1);
+    char *out = result;
+    int run = 0;
     for (int i = 0; i < len; i++) {
-      unsigned c = (unsigned)(unsigned char)s[i];
-      if (c < 128 && URI_UNRESERVED[c]) {
-        result[ri++] = (char)c;
-      } else {
-        result[ri++] = '%';
-        result[ri++] = "0123456789ABCDEF"[c >> 4];
-        result[ri++] = "0123456789ABCDEF"[c & 0x0F];
+      unsigned c = s[i];
+      if (!(c < 128 && URI_UNRESERVED[c])) {
+        memcpy(out, s + run, i - run);
+        out += i - run;
+        *out++ = '%';
+        *out++ = "0123456789ABCDEF"[c >> 4];
+        *out++ = "0123456789ABCDEF"[c & 0x0F];
+        run = i + 1;
       }
     }
-    jv line = jv_string_sized(result, ri);
+    memcpy(out, s + run, len - run);
+    jv line = jv_string_sized(result, out_len);
     free(result);
     jv_free(input);
     return line;
@@ -775,24 +815,35 @@ static jv f_format(jq_state *jq, jv input, jv fmt) {
   } else if (!strcmp(fmt_s, "base64")) {
     jv_free(fmt);
     input = f_tostring(jq, input);
-    jv line = jv_string("");
     const unsigned char* data = (const unsigned char*)jv_string_value(input);
     int len = jv_string_length_bytes(jv_copy(input));
-    for (int i=0; i<len; i+=3) {
-      uint32_t code = 0;
-      int n = len - i >= 3 ? 3 : len-i;
-      for (int j=0; j<3; j++) {
-        code <<= 8;
-        code |= j < n ? (unsigned)data[i+j] : 0;
-      }
-      char buf[4];
-      for (int j=0; j<4; j++) {
-        buf[j] = BASE64_ENCODE_TABLE[(code >> (18 - j*6)) & 0x3f];
-      }
-      if (n < 3) buf[3] = '=';
-      if (n < 2) buf[2] = '=';
-      line = jv_string_append_buf(line, buf, sizeof(buf));
+    size_t out_len = ((size_t)len + 2) / 3 * 4;
+    if (out_len >= INT_MAX) {
+      jv_free(input);
+      return jv_invalid_with_msg(jv_string("String too long"));
+    }
+    char *result = jv_mem_alloc(out_len + 1);
+    char *out = result;
+    int i = 0;
+    for (; len - i >= 3; i += 3) {
+      uint32_t code = (uint32_t)data[i] << 16 | (uint32_t)data[i+1] << 8 | data[i+2];
+      out[0] = BASE64_ENCODE_TABLE[code >> 18];
+      out[1] = BASE64_ENCODE_TABLE[(code >> 12) & 0x3f];
+      out[2] = BASE64_ENCODE_TABLE[(code >> 6) & 0x3f];
+      out[3] = BASE64_ENCODE_TABLE[code & 0x3f];
+      out += 4;
+    }
+    if (i < len) {
+      uint32_t code = (uint32_t)data[i] << 16;
+      if (len - i == 2)
+        code |= (uint32_t)data[i+1] << 8;
+      out[0] = BASE64_ENCODE_TABLE[code >> 18];
+      out[1] = BASE64_ENCODE_TABLE[(code >> 12) & 0x3f];
+      out[2] = len - i == 2 ? BASE64_ENCODE_TABLE[(code >> 6) & 0x3f] : '=';
+      out[3] = '=';
     }
+    jv line = jv_string_sized(result, out_len);
+    free(result);
     jv_free(input);
     return line;
   } else if (!strcmp(fmt_s, "base64d")) {
@@ -805,7 +856,23 @@ static jv f_format(jq_state *jq, jv input, jv fmt) {
     uint32_t ri = 0;
     int input_bytes_read=0;
     uint32_t code = 0;
-    for (int i=0; i<len && data[i] != '='; i++) {
+    int i = 0;
+    // Decode whole quads while they hold no padding or invalid bytes;
+    // both have one of the top two bits set in the decode table.
+    for (; len - i >= 4; i += 4) {
+      unsigned a = BASE64_DECODE_TABLE[data[i]];
+      unsigned b = BASE64_DECODE_TABLE[data[i+1]];
+      unsigned c = BASE64_DECODE_TABLE[data[i+2]];
+      unsigned d = BASE64_DECODE_TABLE[data[i+3]];
+      if ((a | b | c | d) & 0xC0)
+        break;
+      code = a << 18 | b << 12 | c << 6 | d;
+      result[ri++] = (code >> 16) & 0xFF;
+      result[ri++] = (code >> 8) & 0xFF;
+      result[ri++] = code & 0xFF;
+    }
+    code = 0;
+    for (; i<len && data[i] != '='; i++) {
       if (BASE64_DECODE_TABLE[data[i]] == BASE64_INVALID_ENTRY) {
         free(result);
         return type_error(input, "is not valid base64 data");
@@ -1043,14 +1110,14 @@ static jv f_match(jq_state *jq, jv input, jv regex, jv modifiers, jv testmode) {
           jv_string((char*)ebuf)));
   }
   result = test ? jv_false() : jv_array();
-  const char *input_string = jv_string_value(input);
-  const UChar* start = (const UChar*)jv_string_value(input);
+  const char *input_string = jvp_string_bytes(input);
+  const UChar* start = (const UChar*)input_string;
   const unsigned long length = jv_string_length_bytes(jv_copy(input));
   const UChar* end = start + length;
   region = onig_region_new();
   do {
     onigret = onig_search(reg,
-        (const UChar*)jv_string_value(input), end, /* string boundaries */
+        (const UChar*)input_string, end, /* string boundaries */
         start, end, /* search boundaries */
         region, ONIG_OPTION_NONE);
     if (onigret >= 0) {
@@ -1110,7 +1177,7 @@ static jv f_match(jq_state *jq, jv input, jv regex, jv modifiers, jv testmode) {
 
       unsigned long blen = region->end[0]-region->beg[0];
       match = jv_object_set(match, jv_string("length"), jv_number(len));
-      match = jv_object_set(match, jv_string("string"), jv_string_sized(input_string+region->beg[0],blen));
+      match = jv_object_set(match, jv_string("string"), jvp_string_sub(jv_copy(input), region->beg[0], blen));
       jv captures = jv_array();
       for (int i = 1; i < region->num_regs; ++i) {
         // Empty capture.
@@ -1142,7 +1209,7 @@ static jv f_match(jq_state *jq, jv input, jv regex, jv modifiers, jv testmode) {
         blen = region->end[i]-region->beg[i];
         jv cap = jv_object_set(jv_object(), jv_string("offset"), jv_number(idx));
         cap = jv_object_set(cap, jv_string("length"), jv_number(len));
-        cap = jv_object_set(cap, jv_string("string"), jv_string_sized(input_string+region->beg[i],blen));
+        cap = jv_object_set(cap, jv_string("string"), jvp_string_sub(jv_copy(input), region->beg[i], blen));
         cap = jv_object_set(cap, jv_string("name"), jv_null());
         captures = jv_array_append(captures,cap);
       }
@@ -1340,6 +1407,13 @@ static jv f_get_jq_origin(jq_state *jq, jv input) {
   return jq_get_jq_origin(jq);
 }
 
+static jv f_memstats(jq_state *jq, jv input) {
+  // The input may be the last reference to it, so count it first
+  jv ret = jq_get_memstats(jq);
+  jv_free(input);
+  return ret;
+}
+
 static jv f_string_split(jq_state *jq, jv a, jv b) {
   if (jv_get_kind(a) != JV_KIND_STRING || jv_get_kind(b) != JV_KIND_STRING) {
     return ret_error2(a, b, jv_string("split input and separator must be strings"));
@@ -1366,6 +1440,18 @@ static jv f_string_indexes(jq_state *jq, jv a, jv b) {
   return jv_string_indexes(a, b);
 }
 
+// The first (or last) of indices(b), without finding the others
+static jv index_of(jv a, jv b, int last) {
+  if (jv_get_kind(a) == JV_KIND_ARRAY && jv_get_kind(b) == JV_KIND_ARRAY)
+    return jvp_array_index(a, b, last);
+  if (jv_get_kind(a) == JV_KIND_STRING && jv_get_kind(b) == JV_KIND_STRING)
+    return jvp_string_index(a, b, last);
+  return ret_error2(a, b, jv_string("Can only search strings in strings and arrays in arrays"));
+}
+
+static jv f_index(jq_state *jq, jv a, jv b)  { return index_of(a, b, 0); }
+static jv f_rindex(jq_state *jq, jv a, jv b) { return index_of(a, b, 1); }
+
 enum trim_op {
   TRIM_LEFT  = 1 << 0,
   TRIM_RIGHT = 1 << 1
@@ -1409,15 +1495,55 @@ static jv string_trim(jv a, int op) {
   if (trim_start == start && trim_end == end)
     return a;
 
-  jv ts = jv_string_sized(trim_start, trim_end - trim_start);
-  jv_free(a);
-  return ts;
+  return jvp_string_sub(a, trim_start - start, trim_end - trim_start);
 }
 
 static jv f_string_trim(jq_state *jq, jv a)  { return string_trim(a, TRIM_LEFT | TRIM_RIGHT); }
 static jv f_string_ltrim(jq_state *jq, jv a) { return string_trim(a, TRIM_LEFT); }
 static jv f_string_rtrim(jq_state *jq, jv a) { return string_trim(a, TRIM_RIGHT); }
 
+// Removes b from the start and/or end of a, where a starts or ends with it
+static jv string_trimstr(jv a, jv b, int op) {
+  if (jv_get_kind(a) != JV_KIND_STRING || jv_get_kind(b) != JV_KIND_STRING) {
+    return ret_error2(a, b, jv_string(op & TRIM_LEFT ?
+                                      "startswith() requires string inputs" :
+                                      "endswith() requires string inputs"));
+  }
+  const char *astr = jv_string_value(a);
+  const char *bstr = jv_string_value(b);
+  int start = 0;
+  int end = jv_string_length_bytes(jv_copy(a));
+  int blen = jv_string_length_bytes(jv_copy(b));
+
+  if ((op & TRIM_LEFT) && blen <= end && memcmp(astr, bstr, blen) == 0)
+    start = blen;
+  if ((op & TRIM_RIGHT) && blen <= end - start &&
+      memcmp(astr + end - blen, bstr, blen) == 0)
+    end -= blen;
+  jv_free(b);
+  return jvp_string_sub(a, start, end - start);
+}
+
+static jv f_ltrimstr(jq_state *jq, jv a, jv b) { return string_trimstr(a, b, TRIM_LEFT); }
+static jv f_rtrimstr(jq_state *jq, jv a, jv b) { return string_trimstr(a, b, TRIM_RIGHT); }
+static jv f_trimstr(jq_state *jq, jv a, jv b)  { return string_trimstr(a, b, TRIM_LEFT | TRIM_RIGHT); }
+
+// Like ruby's downcase and upcase, only the characters A to Z and a to z
+// are affected
+static jv f_ascii_downcase(jq_state *jq, jv a) {
+  if (jv_get_kind(a) != JV_KIND_STRING) {
+    return ret_error(a, jv_string("ascii_downcase input must be a string"));
+  }
+  return jvp_string_ascii_case(a, 'A');
+}
+
+static jv f_ascii_upcase(jq_state *jq, jv a) {
+  if (jv_get_kind(a) != JV_KIND_STRING) {
+    return ret_error(a, jv_string("ascii_upcase input must be a string"));
+  }
+  return jvp_string_ascii_case(a, 'a');
+}
+
 static jv f_string_implode(jq_state *jq, jv a) {
   if (jv_get_kind(a) != JV_KIND_ARRAY) {
     return ret_error(a, jv_string("implode input must be an array"));
@@ -1455,6 +1581,332 @@ static jv f_getpath(jq_state *jq, jv a, jv b) {
 static jv f_delpaths(jq_state *jq, jv a, jv b) { return jv_delpaths(a, b); }
 static jv f_has(jq_state *jq, jv a, jv b) { return jv_has(a, b); }
 
+/*
+ * tostream walks its input once.  Its state, which recurse() hands from
+ * one call of _tostream_next to the next, is [event, path, containers,
+ * positions]: the event to output, the path to the value it's about,
+ * the containers along that path, and where the walk is in each.
+ */
+
+// Element i of *a, leaving null in its place so that the element isn't
+// shared with *a and can be modified in place
+static jv take(jv *a, int i) {
+  jv x = jv_array_get(jv_copy(*a), i);
+  *a = jv_array_set(*a, i, jv_null());
+  return x;
+}
+
+// Finds the first child of v and its key, returning 0 if it has none
+static int stream_first_child(jv v, int *pos, jv *key, jv *child) {
+  if (jv_get_kind(v) == JV_KIND_ARRAY && jv_array_length(jv_copy(v)) > 0) {
+    *pos = 0;
+    *key = jv_number(0);
+    *child = jv_array_get(jv_copy(v), 0);
+    return 1;
+  }
+  if (jv_get_kind(v) == JV_KIND_OBJECT && jv_object_iter_valid(v, *pos = jv_object_iter(v))) {
+    *key = jv_object_iter_key(v, *pos);
+    *child = jv_object_iter_value(v, *pos);
+    return 1;
+  }
+  return 0;
+}
+
+// Goes down from v to its first leaf, whose event is [path, leaf]
+static jv tostream_descend(jv path, jv nodes, jv positions, jv v) {
+  int pos;
+  jv key, child;
+  while (stream_first_child(v, &pos, &key, &child)) {
+    path = jv_array_append(path, key);
+    nodes = jv_array_append(nodes, v);
+    positions = jv_array_append(positions, jv_number(pos));
+    v = child;
+  }
+  return JV_ARRAY(JV_ARRAY(jv_copy(path), v), path, nodes, positions);
+}
+
+static jv f_tostream_init(jq_state *jq, jv input) {
+  return tostream_descend(jv_array(), jv_array(), jv_array(), input);
+}
+
+static jv f_tostream_next(jq_state *jq, jv state) {
+  jv path = take(&state, 1);
+  jv nodes = take(&state, 2);
+  jv positions = take(&state, 3);
+  jv_free(state);
+  int depth = jv_array_length(jv_copy(nodes));
+  if (depth == 0) {
+    jv_free(path);
+    jv_free(nodes);
+    jv_free(positions);
+    return jv_invalid();
+  }
+
+  // Go on to the next child of the innermost container, if it has one
+  jv c = jv_array_get(jv_copy(nodes), depth - 1);
+  int pos = jv_number_value(jv_array_get(jv_copy(positions), depth - 1));
+  jv key = jv_invalid(), child = jv_invalid();
+  if (jv_get_kind(c) == JV_KIND_ARRAY) {
+    if (++pos < jv_array_length(jv_copy(c))) {
+      key = jv_number(pos);
+      child = jv_array_get(jv_copy(c), pos);
+    }
+  } else if (jv_object_iter_valid(c, pos = jv_object_iter_next(c, pos))) {
+    key = jv_object_iter_key(c, pos);
+    child = jv_object_iter_value(c, pos);
+  }
+  jv_free(c);
+  if (jv_is_valid(key)) {
+    path = jv_array_set(path, depth - 1, key);
+    positions = jv_array_set(positions, depth - 1, jv_number(pos));
+    return tostream_descend(path, nodes, positions, child);
+  }
+
+  // Otherwise close it, with the path to its last child
+  jv event = JV_ARRAY(jv_copy(path));
+  return JV_ARRAY(event,
+                  jv_array_slice(path, 0, depth - 1),
+                  jv_array_slice(nodes, 0, depth - 1),
+                  jv_array_slice(positions, 0, depth - 1));
+}
+
+static int stream_event_valid(jv event) {
+  if (jv_get_kind(event) != JV_KIND_ARRAY)
+    return 0;
+  jv path = jv_array_get(jv_copy(event), 0);
+  int valid = jv_get_kind(path) == JV_KIND_ARRAY;
+  jv_free(path);
+  return valid;
+}
+
+// event[0] and its length, as the jq definitions took them from events
+// of any shape
+static jv stream_event_path(jq_state *jq, jv event, double *len) {
+  jv path = jv_get(event, jv_number(0));
+  if (!jv_is_valid(path))
+    return path;
+  jv n = f_length(jq, jv_copy(path));
+  if (!jv_is_valid(n)) {
+    jv_free(path);
+    return n;
+  }
+  *len = jv_number_value(n);
+  jv_free(n);
+  return path;
+}
+
+/*
+ * fromstream's state is [value, done]: the value being rebuilt from the
+ * events so far, which foreach leaves unshared between events so that
+ * it's updated in place, and whether it's complete.
+ */
+static jv f_fromstream_update(jq_state *jq, jv state, jv event) {
+  if (jv_get_kind(state) != JV_KIND_ARRAY)
+    state = JV_ARRAY(jv_null(), jv_false());
+  jv value = take(&state, 0);
+  jv done_before = jv_array_get(jv_copy(state), 1);
+  if (jv_get_kind(done_before) == JV_KIND_TRUE) {
+    jv_free(value);
+    value = jv_null();
+  }
+  jv_free(done_before);
+
+  jv path;
+  int leaf;
+  double depth;
+  if (stream_event_valid(event)) {
+    leaf = jv_array_length(jv_copy(event)) == 2;
+    path = jv_array_get(jv_copy(event), 0);
+    depth = jv_array_length(jv_copy(path));
+  } else {
+    // Anything else goes the way `{x: value} | setpath(["x"] + $i[0];
+    // $i[1])` or the closing event's `$i[0] | length == 1` sent it
+    jv n = f_length(jq, jv_copy(event));
+    leaf = jv_is_valid(n) && jv_number_value(n) == 2;
+    if (jv_is_valid(n)) {
+      jv_free(n);
+      path = stream_event_path(jq, jv_copy(event), &depth);
+    } else {
+      path = n;
+    }
+    if (jv_get_kind(path) == JV_KIND_NULL) {
+      jv_free(path);
+      path = jv_array();
+    } else if (leaf && jv_is_valid(path)) {
+      path = type_error2(JV_ARRAY(jv_string("x")), path, "cannot be added");
+    }
+    if (!jv_is_valid(path)) {
+      jv_free(value);
+      jv_free(state);
+      jv_free(event);
+      return path;
+    }
+  }
+
+  int done;
+  if (leaf) {
+    done = depth == 0;
+    value = jv_setpath(value, path, jv_array_get(event, 1));
+    if (!jv_is_valid(value)) {
+      jv_free(state);
+      return value;
+    }
+  } else {
+    done = depth == 1;
+    jv_free(path);
+    jv_free(event);
+  }
+  state = jv_array_set(state, 0, value);
+  return jv_array_set(state, 1, jv_bool(done));
+}
+
+static jv f_truncate_stream(jq_state *jq, jv event, jv depth) {
+  if (!stream_event_valid(event) || jv_get_kind(depth) != JV_KIND_NUMBER) {
+    // As `(.[0] | length) > $n | .[0] |= .[$n:]` did: depths that sort
+    // above numbers drop every event, null keeps the whole path and
+    // booleans fail as slice indices.  Events need only be indexable.
+    double len;
+    jv path = stream_event_path(jq, jv_copy(event), &len);
+    if (jv_is_valid(path) && jv_cmp(jv_number(len), jv_copy(depth)) <= 0) {
+      jv_free(path);
+      path = jv_invalid();
+    } else if (jv_is_valid(path)) {
+      path = jv_get(path, JV_OBJECT(jv_string("start"), jv_copy(depth),
+                                    jv_string("end"), jv_null()));
+      if (jv_is_valid(path))
+        path = jv_setpath(jv_copy(event), JV_ARRAY(jv_number(0)), path);
+    }
+    jv_free(event);
+    jv_free(depth);
+    return path;
+  }
+  double n = jv_number_value(depth);
+  jv_free(depth);
+  jv path = take(&event, 0);
+  int len = jv_array_length(jv_copy(path));
+  if (len <= n) {
+    jv_free(path);
+    jv_free(event);
+    return jv_invalid();
+  }
+  return jv_array_set(event, 0, jv_array_slice(path, n < -len ? 0 : (int)n, len));
+}
+
+/*
+ * _modify(paths; update)'s state is [root, deletions]: the value being
+ * updated, and the paths at which update was empty, to delete at the end.
+ * The state is only ever held by the reduce, so these update it in place
+ * rather than going through setpath([0] + $p; ...).
+ */
+
+// jv_setpath(root, path[i:], v), without slicing path at each level
+static jv modify_set(jv root, jv path, int i, int n, jv v) {
+  if (i == n) {
+    jv_free(root);
+    return v;
+  }
+  jv k = jv_array_get(jv_copy(path), i);
+  if (jv_get_kind(k) == JV_KIND_OBJECT) {
+    jv_free(k);
+    return jv_setpath(root, jv_array_slice(jv_copy(path), i, n), v);
+  }
+  jv sub = jv_get(jv_copy(root), jv_copy(k));
+  if (!jv_is_valid(sub)) {
+    jv_free(root);
+    jv_free(k);
+    jv_free(v);
+    return sub;
+  }
+  root = jv_set(root, jv_copy(k), jv_null());
+  if (!jv_is_valid(root)) {
+    jv_free(sub);
+    jv_free(k);
+    jv_free(v);
+    return root;
+  }
+  return jv_set(root, k, modify_set(sub, path, i + 1, n, v));
+}
+
+static jv f_modify_set(jq_state *jq, jv state, jv path, jv v) {
+  jv root = modify_set(take(&state, 0), path, 0, jv_array_length(jv_copy(path)), v);
+  jv_free(path);
+  if (!jv_is_valid(root)) {
+    jv_free(state);
+    return root;
+  }
+  return jv_array_set(state, 0, root);
+}
+
+static jv f_modify_delete(jq_state *jq, jv state, jv path) {
+  jv deletions = take(&state, 1);
+  return jv_array_set(state, 1, jv_array_append(deletions, path));
+}
+
+static jv f_modify_end(jq_state *jq, jv state) {
+  jv root = take(&state, 0);
+  jv deletions = take(&state, 1);
+  jv_free(state);
+  if (jv_array_length(jv_copy(deletions)) == 0) {
+    jv_free(deletions);
+    return root;
+  }
+  return jv_delpaths(root, deletions);
+}
+
+/*
+ * walk(f) walks the children of a container in jq, as f has to run
+ * there, and then rebuilds the container from their results here.  If
+ * every result is the original child (the same jv), the container
+ * itself is returned, so that subtrees f leaves alone are shared with
+ * the input rather than copied.
+ */
+
+// results holds the outputs of walking each element of input, in order
+static jv f_walk_array(jq_state *jq, jv input, jv results) {
+  assert(jv_get_kind(input) == JV_KIND_ARRAY);
+  assert(jv_get_kind(results) == JV_KIND_ARRAY);
+  int n = jv_array_length(jv_copy(input));
+  if (jv_array_length(jv_copy(results)) != n) {
+    jv_free(input);
+    return results;
+  }
+  for (int i = 0; i < n; i++) {
+    if (!jv_identical(jv_array_get(jv_copy(input), i),
+                      jv_array_get(jv_copy(results), i))) {
+      jv_free(input);
+      return results;
+    }
+  }
+  jv_free(results);
+  return input;
+}
+
+// results holds, for each value of input in .[] order, [] if walking it
+// produced nothing and its key is to be deleted, or else its first output
+static jv f_walk_object(jq_state *jq, jv input, jv results) {
+  assert(jv_get_kind(input) == JV_KIND_OBJECT);
+  assert(jv_get_kind(results) == JV_KIND_ARRAY);
+  jv r = jv_copy(input);
+  int i = 0;
+  for (int it = jv_object_iter(input); jv_object_iter_valid(input, it);
+       it = jv_object_iter_next(input, it), i++) {
+    jv result = jv_array_get(jv_copy(results), i);
+    if (jv_array_length(jv_copy(result)) == 0) {
+      r = jv_object_delete(r, jv_object_iter_key(input, it));
+      jv_free(result);
+      continue;
+    }
+    jv v = jv_array_get(result, 0);
+    if (jv_identical(jv_copy(v), jv_object_iter_value(input, it)))
+      jv_free(v);
+    else
+      r = jv_object_set(r, jv_object_iter_key(input, it), v);
+  }
+  jv_free(input);
+  jv_free(results);
+  return r;
+}
+
 static jv f_modulemeta(jq_state *jq, jv a) {
   if (jv_get_kind(a) != JV_KIND_STRING) {
     return ret_error(a, jv_string("modulemeta input module name must be a string"));
@@ -1628,6 +2080,145 @@ static void set_tm_yday(struct tm *tm) {
   tm->tm_yday = yday;
 }
 
+/*
+ * The ISO 8601 format of fromdateiso8601 and todateiso8601 is common
+ * enough to be worth handling without strptime(), strftime() and
+ * timegm(): these convert it straight to and from seconds since the
+ * epoch, with the proleptic Gregorian calendar those use too.
+ */
+#define ISO8601_FORMAT "%Y-%m-%dT%H:%M:%SZ"
+
+// Days from 1970-01-01 to y-m-d, where d may run past the end of month m
+static int64_t days_from_civil(int64_t y, int m, int d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = (int)(y - era * 400);
+  int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// The inverse of days_from_civil()
+static void civil_from_days(int64_t days, int *y, int *m, int *d) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int doe = (int)(days - era * 146097);
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+// Reads n digits at *p into *v, failing unless there are and *v <= max
+static int iso8601_number(const char **p, int n, int max, int *v) {
+  *v = 0;
+  for (int i = 0; i < n; i++, (*p)++) {
+    if (**p < '0' || **p > '9')
+      return 0;
+    *v = *v * 10 + (**p - '0');
+  }
+  return *v <= max;
+}
+
+/*
+ * Parses s as YYYY-MM-DDTHH:MM:SSZ, as strptime(ISO8601_FORMAT) does, but
+ * only for dates that exist.  If secs is given, fractional seconds and an
+ * offset +HH:MM or -HH:MM in place of the Z are allowed as well, as in
+ * RFC 3339, and the seconds since the epoch are stored there; days past
+ * the end of the month then run into the next, as they do with timegm().
+ */
+static int iso8601_parse(const char *s, struct tm *tm, double *secs) {
+  int year, mon, mday, hour, min, sec;
+  if (!iso8601_number(&s, 4, 9999, &year) || *s++ != '-' ||
+      !iso8601_number(&s, 2, 12, &mon) || *s++ != '-' ||
+      !iso8601_number(&s, 2, 31, &mday) || mon == 0 || mday == 0)
+    return 0;
+  if (*s != 'T' && !(*s == 't' && secs != NULL))
+    return 0;
+  s++;
+  if (!iso8601_number(&s, 2, 23, &hour) || *s++ != ':' ||
+      !iso8601_number(&s, 2, 59, &min) || *s++ != ':' ||
+      !iso8601_number(&s, 2, 60, &sec))
+    return 0;
+  if (secs == NULL) {
+    static const int mdays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (mday > mdays[mon - 1] || (mon == 2 && mday == 29 && !leap))
+      return 0;
+  }
+
+  double frac = 0;
+  int offset = 0;
+  if (secs != NULL && *s == '.') {
+    const char *start = ++s;
+    double scale = 1;
+    for (; *s >= '0' && *s <= '9'; s++)
+      frac += (*s - '0') * (scale /= 10);
+    if (s == start)
+      return 0;
+  }
+  if (*s == 'Z' || (*s == 'z' && secs != NULL)) {
+    s++;
+  } else if (secs != NULL && (*s == '+' || *s == '-')) {
+    int sign = *s++ == '-' ? -1 : 1;
+    int oh, om;
+    if (!iso8601_number(&s, 2, 23, &oh) || *s++ != ':' ||
+        !iso8601_number(&s, 2, 59, &om))
+      return 0;
+    offset = sign * (oh * 3600 + om * 60);
+  } else {
+    return 0;
+  }
+  if (*s != '\0')
+    return 0;
+
+  int64_t days = days_from_civil(year, mon, mday);
+  memset(tm, 0, sizeof(*tm));
+  tm->tm_year = year - 1900;
+  tm->tm_mon = mon - 1;
+  tm->tm_mday = mday;
+  tm->tm_hour = hour;
+  tm->tm_min = min;
+  tm->tm_sec = sec;
+  tm->tm_wday = (int)(((days + 4) % 7 + 7) % 7);
+  tm->tm_yday = (int)(days - days_from_civil(year, 1, 1));
+  if (secs != NULL)
+    *secs = days * 86400 + hour * 3600 + min * 60 + sec - offset + frac;
+  return 1;
+}
+
+#ifdef HAVE_STRFTIME
+// Writes the n last digits of v at p
+static void iso8601_digits(char *p, int v, int n) {
+  while (n-- > 0) {
+    p[n] = '0' + v % 10;
+    v /= 10;
+  }
+}
+
+// Formats t as todateiso8601 does, returning 0 if t is out of its range
+static int iso8601_format(double t, char buf[sizeof("YYYY-MM-DDTHH:MM:SSZ")]) {
+  // 1000-01-01 to 9999-12-31, where strftime()'s %Y has four digits
+  if (!(t >= -30610224000.0 && t < 253402300800.0))
+    return 0;
+  int64_t secs = (int64_t)t;  // towards zero, as gmtime's time_t
+  int64_t days = (secs >= 0 ? secs : secs - 86399) / 86400;
+  int rem = (int)(secs - days * 86400);
+  int y, m, d;
+  civil_from_days(days, &y, &m, &d);
+  memcpy(buf, "YYYY-MM-DDTHH:MM:SSZ", sizeof("YYYY-MM-DDTHH:MM:SSZ"));
+  iso8601_digits(buf, y, 4);
+  iso8601_digits(buf + 5, m, 2);
+  iso8601_digits(buf + 8, d, 2);
+  iso8601_digits(buf + 11, rem / 3600, 2);
+  iso8601_digits(buf + 14, rem / 60 % 60, 2);
+  iso8601_digits(buf + 17, rem % 60, 2);
+  return 1;
+}
+#endif
+
 static jv f_strptime(jq_state *jq, jv a, jv b) {
   if (jv_get_kind(a) != JV_KIND_STRING || jv_get_kind(b) != JV_KIND_STRING) {
     return ret_error2(a, b, jv_string("strptime/1 requires string inputs and arguments"));
@@ -1640,6 +2231,11 @@ static jv f_strptime(jq_state *jq, jv a, jv b) {
 
   const char *input = jv_string_value(a);
   const char *fmt = jv_string_value(b);
+  if (strcmp(fmt, ISO8601_FORMAT) == 0 && iso8601_parse(input, &tm, NULL)) {
+    jv_free(a);
+    jv_free(b);
+    return tm2jv(&tm, 0);
+  }
   const char *end = strptime(input, fmt, &tm);
   if (end == NULL || (*end != '\0' && !isspace((unsigned char)*end))) {
     return ret_error2(a, b, jv_string_fmt("date \"%s\" does not match format \"%s\"", input, fmt));
@@ -1750,6 +2346,17 @@ static jv f_mktime(jq_state *jq, jv a) {
   return jv_number(t);
 }
 
+static jv f_fromdateiso8601(jq_state *jq, jv a) {
+  struct tm tm;
+  double secs;
+  if (jv_get_kind(a) == JV_KIND_STRING && iso8601_parse(jv_string_value(a), &tm, &secs)) {
+    jv_free(a);
+    return jv_number(secs);
+  }
+  jv r = f_strptime(jq, a, jv_string(ISO8601_FORMAT));
+  return jv_is_valid(r) ? f_mktime(jq, r) : r;
+}
+
 #ifdef HAVE_GMTIME_R
 static jv f_gmtime(jq_state *jq, jv a) {
   if (jv_get_kind(a) != JV_KIND_NUMBER)
@@ -1822,6 +2429,14 @@ static jv f_localtime(jq_state *jq, jv a) {
 
 #ifdef HAVE_STRFTIME
 static jv f_strftime(jq_state *jq, jv a, jv b) {
+  char iso[sizeof("YYYY-MM-DDTHH:MM:SSZ")];
+  if (jv_get_kind(a) == JV_KIND_NUMBER && jv_get_kind(b) == JV_KIND_STRING &&
+      strcmp(jv_string_value(b), ISO8601_FORMAT) == 0 &&
+      iso8601_format(jv_number_value(a), iso)) {
+    jv_free(a);
+    jv_free(b);
+    return jv_string(iso);
+  }
   if (jv_get_kind(a) == JV_KIND_NUMBER) {
     a = f_gmtime(jq, a);
     if (!jv_is_valid(a)) {
@@ -1996,13 +2611,29 @@ BINOPS
   CFUNC(f_string_explode, "explode", 1),
   CFUNC(f_string_implode, "implode", 1),
   CFUNC(f_string_indexes, "_strindices", 2),
+  CFUNC(f_index, "_index", 2),
+  CFUNC(f_rindex, "_rindex", 2),
   CFUNC(f_string_trim, "trim", 1),
   CFUNC(f_string_ltrim, "ltrim", 1),
   CFUNC(f_string_rtrim, "rtrim", 1),
+  CFUNC(f_ltrimstr, "ltrimstr", 2),
+  CFUNC(f_rtrimstr, "rtrimstr", 2),
+  CFUNC(f_trimstr, "trimstr", 2),
+  CFUNC(f_ascii_downcase, "ascii_downcase", 1),
+  CFUNC(f_ascii_upcase, "ascii_upcase", 1),
   CFUNC(f_setpath, "setpath", 3),
   CFUNC(f_getpath, "getpath", 2),
   CFUNC(f_delpaths, "delpaths", 2),
   CFUNC(f_has, "has", 2),
+  CFUNC(f_tostream_init, "_tostream_init", 1),
+  CFUNC(f_tostream_next, "_tostream_next", 1),
+  CFUNC(f_fromstream_update, "_fromstream_update", 2),
+  CFUNC(f_truncate_stream, "_truncate_stream", 2),
+  CFUNC(f_modify_set, "_modify_set", 3),
+  CFUNC(f_modify_delete, "_modify_delete", 2),
+  CFUNC(f_modify_end, "_modify_end", 1),
+  CFUNC(f_walk_array, "_walk_array", 2),
+  CFUNC(f_walk_object, "_walk_object", 2),
   CFUNC(f_contains, "contains", 2),
   CFUNC(f_length, "length", 1),
   CFUNC(f_utf8bytelength, "utf8bytelength", 1),
@@ -2039,11 +2670,13 @@ BINOPS
   CFUNC(f_strftime, "strftime", 2),
   CFUNC(f_strflocaltime, "strflocaltime", 2),
   CFUNC(f_mktime, "mktime", 1),
+  CFUNC(f_fromdateiso8601, "fromdateiso8601", 1),
   CFUNC(f_gmtime, "gmtime", 1),
   CFUNC(f_localtime, "localtime", 1),
   CFUNC(f_now, "now", 1),
   CFUNC(f_current_filename, "input_filename", 1),
   CFUNC(f_current_line, "input_line_number", 1),
+  CFUNC(f_memstats, "memstats", 1),
   CFUNC(f_have_decnum, "have_decnum", 1),
   CFUNC(f_have_decnum, "have_literal_numbers", 1),
 };
@@ -2130,22 +2763,46 @@ static block bind_bytecoded_builtins(block b) {
   return BLOCK(builtins, b);
 }
 
+const struct cfunction* builtins_find_cfunction(const char* name, int nargs) {
+  for (size_t i = 0; i < sizeof(function_list)/sizeof(function_list[0]); i++) {
+    if (function_list[i].nargs == nargs && strcmp(function_list[i].name, name) == 0)
+      return &function_list[i];
+  }
+  return NULL;
+}
+
 static const char jq_builtins[] = {
 /* Include jq-coded builtins */
 #include "src/builtin.inc"
   '\0',
 };
 
+// The bytecode cache keys on this, as its entries may call into it
+const char* builtins_source(size_t* len) {
+  *len = sizeof(jq_builtins) - 1;
+  return jq_builtins;
+}
+
 static block gen_builtin_list(block builtins) {
   jv list = jv_array_append(block_list_funcs(builtins, 1), jv_string("builtins/0"));
   return BLOCK(builtins, gen_function("builtins", gen_noop(), gen_const(list)));
 }
 
+/* The jq-coded builtins above, parsed at build time by src/gen_builtins.c */
+#ifndef JQ_GEN_BUILTINS
+#include "src/builtin_image.inc"
+#endif
+
 int builtins_bind(jq_state *jq, block* bb) {
   block builtins;
   struct locfile* src = locfile_init(jq, "<builtin>", jq_builtins, sizeof(jq_builtins)-1);
+#ifdef JQ_BUILTIN_IMAGE
+  int nerrors = 0;
+  builtins = block_load_image(&jq_builtins_image, src);
+#else
   int nerrors = jq_parse_library(src, &builtins);
   assert(!nerrors);
+#endif
   locfile_free(src);
 
   builtins = bind_bytecoded_builtins(builtins);
@@ -6,6 +6,8 @@
 #include "compile.h"
 
 int builtins_bind(jq_state *, block*);
+const struct cfunction* builtins_find_cfunction(const char*, int);
+const char* builtins_source(size_t*);
 
 #define BINOPS \
   BINOP(plus) \
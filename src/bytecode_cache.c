@@ -0,0 +1,520 @@
+/*
+ * On-disk cache of compiled programs.
+ *
+ * Each entry is a file named after a hash of the cache key, which
+ * covers everything the compiler looks at besides module files: the
+ * jq version and build, the program text, the names of the program arguments
+ * and the module search settings.  The key is stored in the entry and
+ * compared exactly, so hash collisions only cost a recompile.
+ *
+ * Module and data files are recorded with a hash of their contents,
+ * as are the paths where a module was looked for but not found, and
+ * all of them are checked before an entry is used.
+ *
+ * Program arguments and $ENV are compiled into constants.  Entries
+ * store null in their place and get the current values on load, so
+ * one entry serves every run of a program whatever its --arg values.
+ *
+ * Entries are native-endian binary and only meant to be read by the
+ * jq build that wrote them.  They end with a hash of their contents,
+ * and the bytecode in them is checked before it is run.  Any problem
+ * reading or writing the cache just means compiling as usual.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytecode_cache.h"
+#include "builtin.h"
+#include "compile.h"
+#include "jv_alloc.h"
+#include "util.h"
+
+#define CACHE_MAGIC "jqbc"
+#define CACHE_FORMAT 2
+#define CACHE_BYTE_ORDER 0x01020304u
+
+enum { DEP_ABSENT, DEP_FILE, DEP_UNREADABLE };
+
+// FNV-1a: stable across runs and builds, unlike jv's string hash
+static uint64_t cache_hash(uint64_t h, const void *data, size_t len) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+#define CACHE_HASH_INIT 0xcbf29ce484222325ull
+
+static char *read_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return NULL;
+  size_t cap = 4096, n = 0;
+  char *buf = jv_mem_alloc(cap);
+  size_t got;
+  while ((got = fread(buf + n, 1, cap - n, f)) > 0) {
+    n += got;
+    if (n == cap) {
+      cap *= 2;
+      buf = jv_mem_realloc(buf, cap);
+    }
+  }
+  if (ferror(f)) {
+    fclose(f);
+    jv_mem_free(buf);
+    return NULL;
+  }
+  fclose(f);
+  *len = n;
+  return buf;
+}
+
+static int dep_state(const char *path, uint64_t *hash) {
+  struct stat st;
+  *hash = 0;
+  if (stat(path, &st) == -1 && errno == ENOENT)
+    return DEP_ABSENT;
+  size_t len;
+  char *data = read_file(path, &len);
+  if (data == NULL)
+    return DEP_UNREADABLE;
+  *hash = cache_hash(CACHE_HASH_INIT, data, len);
+  jv_mem_free(data);
+  return DEP_FILE;
+}
+
+static jv or_null(jv v) {
+  if (jv_is_valid(v))
+    return v;
+  jv_free(v);
+  return jv_null();
+}
+
+// Identifies the build beyond its version, which dirty trees and
+// patched packages share with others: entries hold bytecode that runs
+// against this build's opcodes and jq-coded builtins.
+static uint64_t build_fingerprint(void) {
+  size_t len;
+  const char *src = builtins_source(&len);
+  uint64_t h = cache_hash(CACHE_HASH_INIT, src, len);
+  for (int op = 0; op < NUM_OPCODES; op++) {
+    const struct opcode_description *d = opcode_describe(op);
+    int32_t shape[] = {d->flags, d->length, d->stack_in, d->stack_out};
+    h = cache_hash(h, d->name, strlen(d->name) + 1);
+    h = cache_hash(h, shape, sizeof(shape));
+  }
+  return h;
+}
+
+jv bytecode_cache_key(jq_state *jq, const char *program, jv args) {
+  jv names = jv_keys(args);
+  return jv_dump_string(JV_ARRAY(jv_number(CACHE_FORMAT),
+                                 jv_string_fmt("%s %016llx", PACKAGE_VERSION,
+                                               (unsigned long long)build_fingerprint()),
+                                 jv_string(program),
+                                 names,
+                                 jq_get_lib_dirs(jq),
+                                 or_null(jq_get_jq_origin(jq)),
+                                 or_null(jq_get_prog_origin(jq)),
+                                 or_null(get_home()),
+                                 or_null(jq_realpath(jv_string(".")))), 0);
+}
+
+static jv cache_path(jv dir, jv key) {
+  uint64_t h = cache_hash(CACHE_HASH_INIT, jv_string_value(key),
+                          jv_string_length_bytes(jv_copy(key)));
+  jv path = jv_string_fmt("%s/%016llx.jqbc", jv_string_value(dir), (unsigned long long)h);
+  jv_free(dir);
+  jv_free(key);
+  return path;
+}
+
+/*
+ * Writing
+ */
+
+struct cache_buf {
+  char *data;
+  size_t len, cap;
+};
+
+static void put(struct cache_buf *b, const void *data, size_t len) {
+  if (b->len + len > b->cap) {
+    b->cap = (b->len + len) * 2;
+    b->data = jv_mem_realloc(b->data, b->cap);
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+}
+
+static void put_int(struct cache_buf *b, int32_t v) {
+  put(b, &v, sizeof(v));
+}
+
+static void put_str(struct cache_buf *b, const char *s, int len) {
+  put_int(b, len);
+  put(b, s, len);
+}
+
+static void put_jv(struct cache_buf *b, jv v) {
+  jv s = jv_dump_string(v, 0);
+  put_str(b, jv_string_value(s), jv_string_length_bytes(jv_copy(s)));
+  jv_free(s);
+}
+
+// Returns 0 if some constant wouldn't survive a trip through JSON.
+static int put_bytecode(struct cache_buf *b, struct bytecode *bc) {
+  put_int(b, bc->codelen);
+  put_int(b, bc->nlocals);
+  put_int(b, bc->nclosures);
+  put_int(b, bc->nsubfunctions);
+  put(b, bc->code, bc->codelen * sizeof(uint16_t));
+
+  jv constants = jv_copy(bc->constants);
+  jv argconsts = jv_object_get(jv_copy(bc->debuginfo), jv_string("argconsts"));
+  if (jv_is_valid(argconsts)) {
+    jv_array_foreach(argconsts, i, ac) {
+      int idx = (int)jv_number_value(jv_array_get(ac, 0));
+      constants = jv_array_set(constants, idx, jv_null());
+    }
+  }
+  jv_free(argconsts);
+  // Folded numbers can come back as literals that print differently
+  jv text = jv_dump_string(jv_copy(constants), 0);
+  jv parsed = jv_parse(jv_string_value(text));
+  int ok = jv_equal(jv_dump_string(jv_copy(parsed), 0), jv_copy(text)) &&
+    jv_equal(parsed, constants);
+  put_str(b, jv_string_value(text), jv_string_length_bytes(jv_copy(text)));
+  jv_free(text);
+  put_jv(b, jv_copy(bc->debuginfo));
+
+  for (int i = 0; ok && i < bc->nsubfunctions; i++)
+    ok = put_bytecode(b, bc->subfunctions[i]);
+  return ok;
+}
+
+void bytecode_cache_store(jv dir, jv key, jv deps, struct bytecode *bc) {
+  struct cache_buf b = {NULL, 0, 0};
+  put(&b, CACHE_MAGIC, 4);
+  put_int(&b, CACHE_BYTE_ORDER);
+  put_str(&b, jv_string_value(key), jv_string_length_bytes(jv_copy(key)));
+
+  put_int(&b, jv_object_length(jv_copy(deps)));
+  jv_object_foreach(deps, path, exists) {
+    uint64_t hash;
+    int state = dep_state(jv_string_value(path), &hash);
+    put_str(&b, jv_string_value(path), jv_string_length_bytes(jv_copy(path)));
+    put_int(&b, state);
+    put(&b, &hash, sizeof(hash));
+    jv_free(path);
+    jv_free(exists);
+  }
+  jv_free(deps);
+
+  struct symbol_table *globals = bc->globals;
+  put_int(&b, globals->ncfunctions);
+  for (int i = 0; i < globals->ncfunctions; i++) {
+    put_str(&b, globals->cfunctions[i].name, strlen(globals->cfunctions[i].name));
+    put_int(&b, globals->cfunctions[i].nargs);
+  }
+
+  if (put_bytecode(&b, bc)) {
+    uint64_t h = cache_hash(CACHE_HASH_INIT, b.data, b.len);
+    put(&b, &h, sizeof(h));
+    // Write under a temporary name so that concurrent runs never see
+    // a partial entry.
+    jv path = cache_path(dir, key);
+    jv tmp = jv_string_fmt("%s.%d", jv_string_value(path), (int)getpid());
+    FILE *f = fopen(jv_string_value(tmp), "wb");
+    if (f != NULL) {
+      int failed = fwrite(b.data, 1, b.len, f) != b.len;
+      failed |= fclose(f) != 0;
+      if (failed || rename(jv_string_value(tmp), jv_string_value(path)) != 0)
+        remove(jv_string_value(tmp));
+    }
+    jv_free(tmp);
+    jv_free(path);
+  } else {
+    jv_free(dir);
+    jv_free(key);
+  }
+  jv_mem_free(b.data);
+}
+
+/*
+ * Reading
+ */
+
+struct cache_reader {
+  const char *p, *end;
+  int error;
+};
+
+static const void *get(struct cache_reader *r, size_t len) {
+  if (r->error || (size_t)(r->end - r->p) < len) {
+    r->error = 1;
+    return NULL;
+  }
+  const void *v = r->p;
+  r->p += len;
+  return v;
+}
+
+static int32_t get_int(struct cache_reader *r) {
+  int32_t v = 0;
+  const void *p = get(r, sizeof(v));
+  if (p)
+    memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static const char *get_str(struct cache_reader *r, int *len) {
+  *len = get_int(r);
+  if (*len < 0)
+    r->error = 1;
+  return get(r, *len);
+}
+
+static jv get_jv(struct cache_reader *r) {
+  int len;
+  const char *s = get_str(r, &len);
+  if (s == NULL)
+    return jv_invalid();
+  return jv_parse_sized(s, len);
+}
+
+static struct bytecode *get_bytecode(struct cache_reader *r, struct bytecode *parent,
+                                     struct symbol_table *globals, jv args, jv *env) {
+  struct bytecode *bc = jv_mem_calloc(1, sizeof(struct bytecode));
+  bc->parent = parent;
+  bc->globals = globals;
+  bc->codelen = get_int(r);
+  bc->nlocals = get_int(r);
+  bc->nclosures = get_int(r);
+  int nsubfunctions = get_int(r);
+  bc->constants = jv_invalid();
+  bc->debuginfo = jv_invalid();
+  const void *code = NULL;
+  if (bc->codelen >= 0 && nsubfunctions >= 0)
+    code = get(r, bc->codelen * sizeof(uint16_t));
+  if (code == NULL) {
+    r->error = 1;
+    return bc;
+  }
+  bc->code = jv_mem_alloc(bc->codelen * sizeof(uint16_t));
+  memcpy(bc->code, code, bc->codelen * sizeof(uint16_t));
+  bc->constants = get_jv(r);
+  bc->debuginfo = get_jv(r);
+  if (jv_get_kind(bc->constants) != JV_KIND_ARRAY ||
+      jv_get_kind(bc->debuginfo) != JV_KIND_OBJECT) {
+    r->error = 1;
+    return bc;
+  }
+
+  jv argconsts = jv_object_get(jv_copy(bc->debuginfo), jv_string("argconsts"));
+  if (jv_is_valid(argconsts)) {
+    jv_array_foreach(argconsts, i, ac) {
+      jv idxv = jv_array_get(jv_copy(ac), 0);
+      jv name = jv_array_get(ac, 1);
+      int idx = jv_get_kind(idxv) == JV_KIND_NUMBER ? (int)jv_number_value(idxv) : -1;
+      jv_free(idxv);
+      jv value;
+      if (jv_get_kind(name) != JV_KIND_STRING) {
+        value = jv_invalid();
+      } else if (strcmp(jv_string_value(name), "ENV") == 0) {
+        value = *env = make_env(*env);
+      } else {
+        value = jv_object_get(jv_copy(args), jv_copy(name));
+      }
+      jv_free(name);
+      if (!jv_is_valid(value) || idx < 0 || idx >= jv_array_length(jv_copy(bc->constants))) {
+        jv_free(value);
+        r->error = 1;
+        break;
+      }
+      bc->constants = jv_array_set(bc->constants, idx, value);
+    }
+  }
+  jv_free(argconsts);
+
+  if (nsubfunctions > 0)
+    bc->subfunctions = jv_mem_calloc(nsubfunctions, sizeof(struct bytecode*));
+  while (!r->error && bc->nsubfunctions < nsubfunctions)
+    bc->subfunctions[bc->nsubfunctions++] = get_bytecode(r, bc, globals, args, env);
+  return bc;
+}
+
+static struct bytecode *get_level(struct bytecode *bc, int level) {
+  while (bc && level-- > 0)
+    bc = bc->parent;
+  return bc;
+}
+
+// Checks that the interpreter can run bc without reading outside it
+// (entries are ours, but files can be truncated, corrupted or swapped):
+// that every instruction is whole and known, and that every constant,
+// variable, builtin, closure and branch target it refers to exists.
+static int valid_bytecode(struct bytecode *bc) {
+  int n = bc->codelen;
+  if (n <= 0)
+    return 0;
+  char *starts = jv_mem_calloc(n, 1);
+  int ok = 1;
+  int pc = 0, last = 0;
+  while (ok && pc < n) {
+    uint16_t *ip = bc->code + pc;
+    const struct opcode_description *op = opcode_describe(*ip);
+    int len = op->length;
+    if (len > 1 && pc + 1 < n && (*ip == CALL_JQ || *ip == TAIL_CALL_JQ))
+      len += ip[1] * 2;
+    if (len <= 0 || len > n - pc) {
+      ok = 0;
+      break;
+    }
+    starts[pc] = 1;
+    last = pc;
+    pc += len;
+  }
+
+  int nconstants = jv_array_length(jv_copy(bc->constants));
+  for (pc = 0; ok && pc < n; pc += bytecode_operation_length(bc->code + pc)) {
+    uint16_t *ip = bc->code + pc;
+    const struct opcode_description *op = opcode_describe(*ip);
+    if (*ip == CALL_BUILTIN) {
+      int nargs = ip[1], func = ip[2];
+      ok = func < bc->globals->ncfunctions &&
+        nargs == bc->globals->cfunctions[func].nargs &&
+        nargs >= 1 && nargs <= MAX_CFUNCTION_ARGS;
+    } else if (*ip == CALL_JQ || *ip == TAIL_CALL_JQ) {
+      // The callee, then the closures passed to it
+      for (int i = 0; ok && i <= ip[1]; i++) {
+        struct bytecode *fr = get_level(bc, ip[2 + i * 2]);
+        int idx = ip[3 + i * 2];
+        if (fr == NULL) {
+          ok = 0;
+        } else if (idx & ARG_NEWCLOSURE) {
+          // Closures passed as arguments take none themselves
+          idx &= ~ARG_NEWCLOSURE;
+          ok = idx < fr->nsubfunctions &&
+            fr->subfunctions[idx]->nclosures == (i == 0 ? ip[1] : 0);
+        } else {
+          // Parameters take no arguments
+          ok = idx < fr->nclosures && (i > 0 || ip[1] == 0);
+        }
+      }
+    } else if (op->flags & OP_HAS_BRANCH) {
+      int target = pc + 2 + ip[1];
+      ok = target < n && starts[target];
+    } else {
+      int imm = 1;
+      if (op->flags & OP_HAS_CONSTANT)
+        ok = ip[imm++] < nconstants;
+      if (ok && (op->flags & OP_HAS_VARIABLE)) {
+        struct bytecode *fr = get_level(bc, ip[imm]);
+        ok = fr != NULL && ip[imm + 1] < fr->nlocals;
+      }
+    }
+  }
+  jv_mem_free(starts);
+
+  // Execution mustn't run off the end
+  uint16_t lastop = bc->code[last];
+  ok = ok && (lastop == RET || lastop == JUMP || lastop == BACKTRACK ||
+              lastop == TAIL_CALL_JQ || lastop == ERRORK);
+  for (int i = 0; ok && i < bc->nsubfunctions; i++)
+    ok = valid_bytecode(bc->subfunctions[i]);
+  return ok;
+}
+
+struct bytecode *bytecode_cache_load(jv dir, jv key, jv args) {
+  jv path = cache_path(dir, jv_copy(key));
+  size_t len;
+  char *data = read_file(jv_string_value(path), &len);
+  jv_free(path);
+  if (data == NULL) {
+    jv_free(key);
+    jv_free(args);
+    return NULL;
+  }
+
+  struct cache_reader r = {data, data + len, 0};
+  struct bytecode *bc = NULL;
+  uint64_t h;
+  if (len < sizeof(h))
+    goto out;
+  r.end -= sizeof(h);
+  memcpy(&h, r.end, sizeof(h));
+  if (h != cache_hash(CACHE_HASH_INIT, data, len - sizeof(h)))
+    goto out;
+  const char *magic = get(&r, 4);
+  int keylen;
+  const char *stored_key;
+  if (magic == NULL || memcmp(magic, CACHE_MAGIC, 4) != 0 ||
+      get_int(&r) != (int32_t)CACHE_BYTE_ORDER ||
+      (stored_key = get_str(&r, &keylen)) == NULL ||
+      keylen != jv_string_length_bytes(jv_copy(key)) ||
+      memcmp(stored_key, jv_string_value(key), keylen) != 0)
+    goto out;
+
+  int ndeps = get_int(&r);
+  for (int i = 0; i < ndeps && !r.error; i++) {
+    int pathlen;
+    const char *s = get_str(&r, &pathlen);
+    int32_t state = get_int(&r);
+    const void *hash = get(&r, sizeof(uint64_t));
+    if (r.error)
+      goto out;
+    char *dep = jv_mem_alloc(pathlen + 1);
+    memcpy(dep, s, pathlen);
+    dep[pathlen] = '\0';
+    uint64_t now;
+    int now_state = dep_state(dep, &now);
+    jv_mem_free(dep);
+    if (now_state != state || memcmp(&now, hash, sizeof(now)) != 0)
+      goto out;
+  }
+
+  int ncfunc = get_int(&r);
+  if (r.error || ncfunc < 0)
+    goto out;
+  struct symbol_table *globals = jv_mem_alloc(sizeof(struct symbol_table));
+  globals->cfunctions = jv_mem_calloc(ncfunc > 0 ? ncfunc : 1, sizeof(struct cfunction));
+  globals->ncfunctions = 0;
+  globals->cfunc_names = jv_array();
+  while (!r.error && globals->ncfunctions < ncfunc) {
+    int namelen;
+    const char *s = get_str(&r, &namelen);
+    int nargs = get_int(&r);
+    if (r.error)
+      break;
+    jv name = jv_string_sized(s, namelen);
+    const struct cfunction *cf = builtins_find_cfunction(jv_string_value(name), nargs);
+    if (cf == NULL) {
+      jv_free(name);
+      r.error = 1;
+      break;
+    }
+    globals->cfunctions[globals->ncfunctions++] = *cf;
+    globals->cfunc_names = jv_array_append(globals->cfunc_names, name);
+  }
+
+  jv env = jv_invalid();
+  bc = get_bytecode(&r, NULL, globals, args, &env);
+  jv_free(env);
+  if (r.error || r.p != r.end || !valid_bytecode(bc)) {
+    bytecode_free(bc);
+    bc = NULL;
+  }
+
+out:
+  jv_mem_free(data);
+  jv_free(key);
+  jv_free(args);
+  return bc;
+}
@@ -0,0 +1,11 @@
+#ifndef BYTECODE_CACHE_H
+#define BYTECODE_CACHE_H
+
+#include "jq.h"
+#include "bytecode.h"
+
+jv bytecode_cache_key(jq_state *, const char *, jv);
+struct bytecode* bytecode_cache_load(jv, jv, jv);
+void bytecode_cache_store(jv, jv, jv, struct bytecode*);
+
+#endif
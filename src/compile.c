@@ -1105,7 +1105,7 @@ static int count_cfunctions(block b) {
 extern char **environ;
 #endif
 
-static jv
+jv
 make_env(jv env)
 {
   if (jv_is_valid(env))
@@ -1215,6 +1215,10 @@ static int expand_call_arglist(block* b, jv args, jv *env) {
   return errors;
 }
 
+static int is_user_source(struct locfile* l) {
+  return strcmp(jv_string_value(l->fname), "<builtin>") != 0;
+}
+
 static int compile(struct bytecode* bc, block b, struct locfile* lf, jv args, jv *env) {
   int errors = 0;
   int pos = 0;
@@ -1309,11 +1313,30 @@ static int compile(struct bytecode* bc, block b, struct locfile* lf, jv args, jv
   bc->code = code;
   pos = 0;
   jv constant_pool = jv_array();
+  jv argconsts = jv_array();
+  jv locations = jv_array();
+  struct locfile* source_file = NULL;
+  location last_source = UNKNOWN_LOCATION;
   int maxvar = -1;
   if (!errors) for (inst* curr = b.first; curr; curr = curr->next) {
     const struct opcode_description* op = opcode_describe(curr->op);
     if (op->length == 0)
       continue;
+    // Record where the source span changes, as [pc, start, end] triples
+    // with -1 for code that has no span.  Only spans in the file of the
+    // first user code seen are kept, so builtins don't appear here.
+    location source = UNKNOWN_LOCATION;
+    if (curr->locfile && (curr->locfile == source_file ||
+                          (!source_file && is_user_source(curr->locfile)))) {
+      source_file = curr->locfile;
+      source = curr->source;
+    }
+    if (source.start != last_source.start || source.end != last_source.end) {
+      locations = jv_array_append(locations, jv_number(pos));
+      locations = jv_array_append(locations, jv_number(source.start));
+      locations = jv_array_append(locations, jv_number(source.end));
+      last_source = source;
+    }
     code[pos++] = curr->op;
     assert(curr->op != CLOSURE_REF && curr->op != CLOSURE_PARAM);
     if (curr->op == CALL_BUILTIN) {
@@ -1342,6 +1365,11 @@ static int compile(struct bytecode* bc, block b, struct locfile* lf, jv args, jv
       code[pos++] = var;
       if (var > maxvar) maxvar = var;
     } else if (op->flags & OP_HAS_CONSTANT) {
+      // Remember which constants are $ENV and program arguments, so
+      // that a cached copy of this bytecode can be given new values.
+      if (curr->op == LOADK && curr->symbol)
+        argconsts = jv_array_append(argconsts, JV_ARRAY(jv_number(jv_array_length(jv_copy(constant_pool))),
+                                                        jv_string(curr->symbol)));
       code[pos++] = jv_array_length(jv_copy(constant_pool));
       constant_pool = jv_array_append(constant_pool, jv_copy(curr->imm.constant));
     } else if (op->flags & OP_HAS_VARIABLE) {
@@ -1359,6 +1387,16 @@ static int compile(struct bytecode* bc, block b, struct locfile* lf, jv args, jv
     }
   }
   bc->constants = constant_pool;
+  if (jv_array_length(jv_copy(argconsts)) > 0)
+    bc->debuginfo = jv_object_set(bc->debuginfo, jv_string("argconsts"), argconsts);
+  else
+    jv_free(argconsts);
+  if (source_file) {
+    bc->debuginfo = jv_object_set(bc->debuginfo, jv_string("file"), jv_copy(source_file->fname));
+    bc->debuginfo = jv_object_set(bc->debuginfo, jv_string("locations"), locations);
+  } else {
+    jv_free(locations);
+  }
   bc->nlocals = maxvar + 2; // FIXME: frames of size zero?
   block_free(b);
   return errors;
@@ -1395,3 +1433,202 @@ void block_free(block b) {
     inst_free(curr);
   }
 }
+
+/*
+ * Block images let a parsed library be compiled into jq as a C table
+ * and rebuilt without running the lexer and parser; see
+ * src/gen_builtins.c.
+ */
+
+static int image_number(block b, int n) {
+  for (inst* i = b.first; i; i = i->next) {
+    i->bytecode_pos = n++;
+    n = image_number(i->subfn, n);
+    n = image_number(i->arglist, n);
+  }
+  return n;
+}
+
+static int image_count(block b) {
+  int n = 0;
+  for (inst* i = b.first; i; i = i->next)
+    n++;
+  return n;
+}
+
+static void image_put_string(FILE* f, const char* s) {
+  if (s == NULL) {
+    fputs("NULL", f);
+    return;
+  }
+  fputc('"', f);
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20 || c >= 0x7f || c == '?')
+      fprintf(f, "\\%03o", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+static void image_unnumber(block b) {
+  for (inst* i = b.first; i; i = i->next) {
+    i->bytecode_pos = -1;
+    image_unnumber(i->subfn);
+    image_unnumber(i->arglist);
+  }
+}
+
+// Flattens b into out from index n, with constants as JSON text
+static int image_flatten(block b, struct inst_image* out, int n) {
+  for (inst* i = b.first; i; i = i->next) {
+    struct inst_image* r = &out[n++];
+    int flags = opcode_describe(i->op)->flags;
+    r->op = i->op;
+    r->target = (flags & OP_HAS_BRANCH) && i->imm.target ? i->imm.target->bytecode_pos : -1;
+    r->bound_by = i->bound_by ? i->bound_by->bytecode_pos : -1;
+    r->symbol = i->symbol;
+    r->constant = NULL;
+    if (flags & OP_HAS_CONSTANT) {
+      jv text = jv_dump_string(jv_copy(i->imm.constant), 0);
+      r->constant = jv_mem_strdup(jv_string_value(text));
+      jv_free(text);
+    }
+    r->nformals = i->nformals;
+    r->nactuals = i->nactuals;
+    r->any_unbound = i->any_unbound;
+    r->referenced = i->referenced;
+    r->nsubfn = image_count(i->subfn);
+    r->narglist = image_count(i->arglist);
+    r->has_locfile = i->locfile != NULL;
+    r->source = i->source;
+    n = image_flatten(i->subfn, out, n);
+    n = image_flatten(i->arglist, out, n);
+  }
+  return n;
+}
+
+static int image_same_const(jv a, jv b) {
+  jv ta = jv_dump_string(jv_copy(a), 0);
+  jv tb = jv_dump_string(jv_copy(b), 0);
+  return jv_equal(ta, tb) && jv_equal(jv_copy(a), jv_copy(b));
+}
+
+static int image_pos(inst* i) {
+  return i ? i->bytecode_pos : -1;
+}
+
+// Returns the first instruction of a, numbered by image_number(), that
+// b doesn't reproduce, or -1
+static int image_mismatch(block a, block b) {
+  inst *i, *j;
+  for (i = a.first, j = b.first; i && j; i = i->next, j = j->next) {
+    int flags = opcode_describe(i->op)->flags;
+    // imm's other fields are only filled in by codegen
+    if (i->op != j->op ||
+        ((flags & OP_HAS_BRANCH) && image_pos(i->imm.target) != image_pos(j->imm.target)) ||
+        image_pos(i->bound_by) != image_pos(j->bound_by) ||
+        (i->symbol == NULL) != (j->symbol == NULL) ||
+        (i->symbol && strcmp(i->symbol, j->symbol) != 0) ||
+        ((flags & OP_HAS_CONSTANT) && !image_same_const(i->imm.constant, j->imm.constant)) ||
+        i->nformals != j->nformals || i->nactuals != j->nactuals ||
+        i->any_unbound != j->any_unbound || i->referenced != j->referenced ||
+        (i->locfile == NULL) != (j->locfile == NULL) ||
+        i->source.start != j->source.start || i->source.end != j->source.end)
+      return i->bytecode_pos;
+    int k = image_mismatch(i->subfn, j->subfn);
+    if (k < 0)
+      k = image_mismatch(i->arglist, j->arglist);
+    if (k >= 0)
+      return k;
+  }
+  if (i || j)
+    return i ? i->bytecode_pos : a.last ? a.last->bytecode_pos : 0;
+  return -1;
+}
+
+/*
+ * Write b as C source defining a struct block_image called name, after
+ * checking that loading the table with lf gives b back.  Returns 1, and
+ * writes nothing, if it doesn't.
+ */
+int block_dump_image(FILE* f, const char* name, block b, struct locfile* lf) {
+  int ninsts = image_number(b, 0);
+  struct inst_image* insts = jv_mem_calloc(ninsts > 0 ? ninsts : 1, sizeof(struct inst_image));
+  image_flatten(b, insts, 0);
+  struct block_image img = {ninsts, image_count(b), insts};
+
+  block back = block_load_image(&img, lf);
+  image_number(back, 0);
+  int bad = image_mismatch(b, back);
+  block_free(back);
+  if (bad >= 0) {
+    const struct inst_image* r = &insts[bad];
+    fprintf(stderr, "jq: error: instruction %d (%s %s %s) doesn't survive a block image\n",
+            bad, opcode_describe(r->op)->name, r->symbol ? r->symbol : "",
+            r->constant ? r->constant : "");
+  } else {
+    fprintf(f, "static const struct inst_image %s_insts[] = {\n", name);
+    for (int k = 0; k < ninsts; k++) {
+      const struct inst_image* r = &insts[k];
+      fprintf(f, "  {%s, %d, %d, ", opcode_describe(r->op)->name, r->target, r->bound_by);
+      image_put_string(f, r->symbol);
+      fputs(", ", f);
+      image_put_string(f, r->constant);
+      fprintf(f, ", %d, %d, %d, %d, %d, %d, %d, {%d, %d}},\n",
+              r->nformals, r->nactuals, r->any_unbound, r->referenced,
+              r->nsubfn, r->narglist, r->has_locfile, r->source.start, r->source.end);
+    }
+    fprintf(f, "};\n\n");
+    fprintf(f, "static const struct block_image %s = {%d, %d, %s_insts};\n",
+            name, ninsts, img.ntop, name);
+  }
+  for (int k = 0; k < ninsts; k++)
+    jv_mem_free((char*)insts[k].constant);
+  jv_mem_free(insts);
+  image_unnumber(b);
+  return bad >= 0;
+}
+
+static block image_load(const struct block_image* img, int* pos, int n,
+                        inst** insts, struct locfile* lf) {
+  block b = gen_noop();
+  while (n-- > 0) {
+    const struct inst_image* r = &img->insts[*pos];
+    inst* i = inst_new(r->op);
+    insts[(*pos)++] = i;
+    if (r->symbol)
+      i->symbol = jv_mem_strdup(r->symbol);
+    if (r->constant)
+      i->imm.constant = jv_parse(r->constant);
+    i->nformals = r->nformals;
+    i->nactuals = r->nactuals;
+    i->any_unbound = r->any_unbound;
+    i->referenced = r->referenced;
+    i->source = r->source;
+    if (r->has_locfile)
+      i->locfile = locfile_retain(lf);
+    i->subfn = image_load(img, pos, r->nsubfn, insts, lf);
+    i->arglist = image_load(img, pos, r->narglist, insts, lf);
+    block_append(&b, inst_block(i));
+  }
+  return b;
+}
+
+block block_load_image(const struct block_image* img, struct locfile* lf) {
+  inst** insts = jv_mem_calloc(img->ninsts, sizeof(inst*));
+  int pos = 0;
+  block b = image_load(img, &pos, img->ntop, insts, lf);
+  assert(pos == img->ninsts);
+  for (int k = 0; k < img->ninsts; k++) {
+    const struct inst_image* r = &img->insts[k];
+    if (opcode_describe(r->op)->flags & OP_HAS_BRANCH)
+      insts[k]->imm.target = r->target < 0 ? NULL : insts[r->target];
+    insts[k]->bound_by = r->bound_by < 0 ? NULL : insts[r->bound_by];
+  }
+  jv_mem_free(insts);
+  return b;
+}
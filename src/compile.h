@@ -80,9 +80,38 @@ jv block_take_imports(block* body);
 jv block_list_funcs(block body, int omit_underscores);
 
 int block_compile(block, struct bytecode**, struct locfile*, jv);
+jv make_env(jv);
 
 void block_free(block);
 
+// A parsed block flattened into a table, as written by block_dump_image().
+// Instructions are in pre-order: each is followed by its subfn, then
+// its arglist. Targets and bindings are indices into the table.
+struct inst_image {
+  opcode op;
+  int target;
+  int bound_by;
+  const char* symbol;
+  const char* constant; // JSON text
+  int nformals;
+  int nactuals;
+  int any_unbound;
+  int referenced;
+  int nsubfn;
+  int narglist;
+  int has_locfile;
+  location source;
+};
+
+struct block_image {
+  int ninsts;
+  int ntop;
+  const struct inst_image* insts;
+};
+
+int block_dump_image(FILE*, const char*, block, struct locfile*);
+block block_load_image(const struct block_image*, struct locfile*);
+
 
 
 // Here's some horrible preprocessor gunk so that code
@@ -15,11 +15,24 @@
 #include "jq.h"
 #include "builtin.h"
 #include "linker.h"
+#include "bytecode_cache.h"
+#include "profile.h"
+#include "memstats.h"
+#include "jv_dtoa_tsd.h"
+#include "util.h"
+
+// Compiled bytecode, immutable once built and refcounted so that any
+// number of jq_states can execute it.
+struct jq_program {
+  int refcnt;
+  struct bytecode* bc;
+  jv attrs;
+};
 
 struct jq_state {
   void (*nomem_handler)(void *);
   void *nomem_handler_data;
-  struct bytecode* bc;
+  jq_program* prog;
 
   jq_msg_cb err_cb;
   void *err_cb_data;
@@ -30,6 +43,10 @@ struct jq_state {
   stack_ptr stk_top;
   stack_ptr fork_top;
 
+  // Inside path(f), the path to the current value.  It's appended to in
+  // place, fork points only record its length, and backtracking slices it
+  // back to that length, so it's only copied when it's appended to while
+  // a path output still refers to it.
   jv path;
   jv value_at_path;
   int subexp_nest;
@@ -48,6 +65,18 @@ struct jq_state {
   void *debug_cb_data;
   jq_msg_cb stderr_cb;
   void *stderr_cb_data;
+
+  struct profile *profile;
+  struct memstats *memstats;
+
+  // Set by jq_set_limit(), and what the current input has used of them
+  double limits[JQ_LIMIT_COUNT];
+  int limited;
+  int over_limit;
+  int64_t mem_base;
+  uint64_t instructions;
+  double time_used;
+  double time_start;
 };
 
 struct closure {
@@ -233,10 +262,7 @@ static int path_intact(jq_state *jq, jv curr) {
 
 static void path_append(jq_state* jq, jv component, jv value_at_path) {
   if (jq->subexp_nest == 0 && jv_get_kind(jq->path) == JV_KIND_ARRAY) {
-    int n1 = jv_array_length(jv_copy(jq->path));
     jq->path = jv_array_append(jq->path, component);
-    int n2 = jv_array_length(jv_copy(jq->path));
-    assert(n2 == n1 + 1);
     jv_free(jq->value_at_path);
     jq->value_at_path = value_at_path;
   } else {
@@ -337,9 +363,70 @@ static void set_error(jq_state *jq, jv value) {
 
 #define ON_BACKTRACK(op) ((op)+NUM_OPCODES)
 
-jv jq_next(jq_state *jq) {
-  jv_nomem_handler(jq->nomem_handler, jq->nomem_handler_data);
+static void profile_step(jq_state *jq, uint16_t *pc, uint16_t opcode, int backtracking) {
+  struct frame* fp = stack_block(&jq->stk, jq->curr_frame);
+  if (profile_switch(jq->profile, fp->bc)) {
+    // Frames below the current one are its callers
+    for (stack_ptr fr = jq->curr_frame; fr; fr = *stack_block_next(&jq->stk, fr))
+      profile_chain_push(jq->profile, ((struct frame*)stack_block(&jq->stk, fr))->bc);
+  }
+  profile_instruction(jq->profile, opcode, backtracking);
+  if (profile_by_source(jq->profile)) {
+    // Code with no source span, such as a builtin, is charged to the
+    // span of the call it was reached through
+    stack_ptr fr = jq->curr_frame;
+    while (!profile_source(jq->profile, fp->bc, pc - fp->bc->code)) {
+      fr = *stack_block_next(&jq->stk, fr);
+      if (!fr) {
+        profile_source(jq->profile, NULL, 0);
+        break;
+      }
+      pc = fp->retaddr - 1;
+      fp = stack_block(&jq->stk, fr);
+    }
+  }
+}
+
+// Returns the limit that the current input has gone over, or -1
+static int check_limits(jq_state *jq) {
+  uint64_t n = ++jq->instructions;
+  if (jq->limits[JQ_LIMIT_INSTRUCTIONS] && n > jq->limits[JQ_LIMIT_INSTRUCTIONS])
+    return JQ_LIMIT_INSTRUCTIONS;
+  if (jq->limits[JQ_LIMIT_MEMORY] &&
+      (jv_mem_budget_refused() ||
+       jv_mem_stats_get()[JV_MEM_TOTAL].live_bytes - jq->mem_base - jq->stk.limit >
+       jq->limits[JQ_LIMIT_MEMORY]))
+    return JQ_LIMIT_MEMORY;
+  // Reading the clock is slow enough to be worth skipping
+  if (jq->limits[JQ_LIMIT_TIME] && (n & 1023) == 0 &&
+      jq->time_used + jq_cpu_ms() - jq->time_start > jq->limits[JQ_LIMIT_TIME])
+    return JQ_LIMIT_TIME;
+  return -1;
+}
 
+static jv limit_error(jq_state *jq, int limit) {
+  jv msg;
+  switch (limit) {
+  case JQ_LIMIT_MEMORY:
+    msg = jv_string_fmt("memory limit of %.0f bytes exceeded", jq->limits[limit]);
+    break;
+  case JQ_LIMIT_INSTRUCTIONS:
+    msg = jv_string_fmt("instruction limit of %.0f exceeded", jq->limits[limit]);
+    break;
+  default:
+    msg = jv_string_fmt("time limit of %.0f ms exceeded", jq->limits[limit]);
+    break;
+  }
+  return jv_invalid_with_msg(msg);
+}
+
+// Inlined twice by jq_next(), with instrumentation on and off, so that
+// the interpreter loop only pays for the profiler's, --debug-memstats'
+// and jq_set_limit()'s hooks when they're used.
+static inline __attribute__((always_inline))
+jv execute(jq_state *jq, int instrumented) {
+  struct profile *profile = instrumented ? jq->profile : NULL;
+  struct memstats *memstats = instrumented ? jq->memstats : NULL;
   uint16_t* pc = stack_restore(jq);
   assert(pc);
 
@@ -390,6 +477,20 @@ jv jq_next(jq_state *jq) {
       printf("\n");
     }
 
+    if (profile)
+      profile_step(jq, pc, opcode, backtracking);
+    if (memstats)
+      memstats_step(memstats, opcode);
+    if (instrumented && jq->limited) {
+      // The error isn't raised in the program, so that it can't be
+      // caught, and execute_instrumented() won't resume it
+      int limit = check_limits(jq);
+      if (limit >= 0) {
+        jq->over_limit = 1;
+        return limit_error(jq, limit);
+      }
+    }
+
     if (backtracking) {
       opcode = ON_BACKTRACK(opcode);
       backtracking = 0;
@@ -911,6 +1012,9 @@ jv jq_next(jq_state *jq) {
         in[i] = stack_pop(jq);
 
       jv top;
+      double start = 0;
+      if (profile)
+        start = jq_wall_ms();
       switch (function->nargs) {
       case 1: top = function->fptr.a1(jq, in[0]); break;
       case 2: top = function->fptr.a2(jq, in[0], in[1]); break;
@@ -918,6 +1022,10 @@ jv jq_next(jq_state *jq) {
       case 4: top = function->fptr.a4(jq, in[0], in[1], in[2], in[3]); break;
       default: assert(0 && "Invalid number of arguments");
       }
+      if (profile)
+        profile_builtin(profile, function, jq_wall_ms() - start);
+      if (memstats)
+        memstats_builtin(memstats, function);
 
       if (!jv_is_valid(top)) {
         if (jv_invalid_has_msg(jv_copy(top)))
@@ -963,6 +1071,8 @@ jv jq_next(jq_state *jq) {
       stack_ptr retdata = jq->stk_top;
       struct frame* new_frame;
       struct closure cl = make_closure(jq, pc);
+      if (profile)
+        profile_call(profile, frame_current(jq)->bc, cl.bc);
       if (opcode == TAIL_CALL_JQ) {
         retaddr = frame_current(jq)->retaddr;
         retdata = frame_current(jq)->retdata;
@@ -1002,6 +1112,48 @@ jv jq_next(jq_state *jq) {
   }
 }
 
+static jv execute_instrumented(jq_state *jq) {
+  // No more outputs for an input that went over a limit
+  if (jq->over_limit)
+    return jv_invalid();
+  if (jq->profile)
+    profile_resume(jq->profile);
+  if (jq->memstats)
+    memstats_resume(jq->memstats);
+  if (jq->limits[JQ_LIMIT_TIME])
+    jq->time_start = jq_cpu_ms();
+  // The interpreter loop holds the input to the limit between
+  // instructions.  The budget lets builtins refuse a single allocation
+  // that would go far past it before they make it; check_limits() then
+  // ends the input even if the program caught their error.
+  if (jq->limits[JQ_LIMIT_MEMORY])
+    jv_mem_budget(jq->mem_base + (int64_t)jq->limits[JQ_LIMIT_MEMORY]);
+  jv ret = execute(jq, 1);
+  if (jq->limits[JQ_LIMIT_MEMORY]) {
+    // Also when the builtin's error was the program's last act
+    if (jv_mem_budget_refused() && !jq->over_limit) {
+      jv_free(ret);
+      jq->over_limit = 1;
+      ret = limit_error(jq, JQ_LIMIT_MEMORY);
+    }
+    jv_mem_budget(0);
+  }
+  if (jq->limits[JQ_LIMIT_TIME])
+    jq->time_used += jq_cpu_ms() - jq->time_start;
+  if (jq->memstats)
+    memstats_pause(jq->memstats);
+  if (jq->profile)
+    profile_pause(jq->profile);
+  return ret;
+}
+
+jv jq_next(jq_state *jq) {
+  jv_nomem_handler(jq->nomem_handler, jq->nomem_handler_data);
+  if (jq->profile || jq->memstats || jq->limited)
+    return execute_instrumented(jq);
+  return execute(jq, 0);
+}
+
 jv jq_format_error(jv msg) {
   if (jv_get_kind(msg) == JV_KIND_NULL ||
       (jv_get_kind(msg) == JV_KIND_INVALID && !jv_invalid_has_msg(jv_copy(msg)))) {
@@ -1057,7 +1209,7 @@ jq_state *jq_init(void) {
   if (jq == NULL)
     return NULL;
 
-  jq->bc = 0;
+  jq->prog = NULL;
   jq->next_label = 0;
 
   stack_init(&jq->stk);
@@ -1088,6 +1240,12 @@ jq_state *jq_init(void) {
 
   jq->nomem_handler = NULL;
   jq->nomem_handler_data = NULL;
+
+  jq->profile = NULL;
+  jq->memstats = jv_mem_stats_enabled ? memstats_new() : NULL;
+  memset(jq->limits, 0, sizeof(jq->limits));
+  jq->limited = 0;
+  jq->over_limit = 0;
   return jq;
 }
 
@@ -1117,15 +1275,20 @@ void jq_start(jq_state *jq, jv input, int flags) {
   jv_nomem_handler(jq->nomem_handler, jq->nomem_handler_data);
   jq_reset(jq);
 
-  struct closure top = {jq->bc, -1};
+  struct closure top = {jq->prog->bc, -1};
   struct frame* top_frame = frame_push(jq, top, 0, 0);
   top_frame->retdata = 0;
   top_frame->retaddr = 0;
 
   stack_push(jq, input);
-  stack_save(jq, jq->bc->code, stack_get_pos(jq));
+  stack_save(jq, jq->prog->bc->code, stack_get_pos(jq));
   jq->debug_trace_enabled = flags & JQ_DEBUG_TRACE_ALL;
   jq->initial_execution = 1;
+
+  jq->mem_base = jv_mem_stats_get()[JV_MEM_TOTAL].live_bytes;
+  jq->instructions = 0;
+  jq->time_used = 0;
+  jq->over_limit = 0;
 }
 
 void jq_teardown(jq_state **jq) {
@@ -1135,9 +1298,11 @@ void jq_teardown(jq_state **jq) {
   *jq = NULL;
 
   jq_reset(old_jq);
-  bytecode_free(old_jq->bc);
-  old_jq->bc = 0;
+  jq_program_free(old_jq->prog);
+  old_jq->prog = NULL;
   jv_free(old_jq->attrs);
+  profile_free(old_jq->profile);
+  memstats_free(old_jq->memstats);
 
   jv_mem_free(old_jq);
 }
@@ -1236,31 +1401,135 @@ int jq_compile_args(jq_state *jq, const char* str, jv args) {
   locations = locfile_init(jq, "<top-level>", str, strlen(str));
   block program;
   jq_reset(jq);
-  if (jq->bc) {
-    bytecode_free(jq->bc);
-    jq->bc = 0;
+  jq_program_free(jq->prog);
+  jq->prog = NULL;
+  if (jq->profile) {
+    profile_reset(jq->profile);
+    profile_set_source(jq->profile, "<top-level>", str);
   }
-  int nerrors = load_program(jq, locations, &program);
-  if (nerrors == 0) {
-    nerrors = builtins_bind(jq, &program);
-    if (nerrors == 0)
-      nerrors = block_compile(program, &jq->bc, locations, args2obj(args));
-    else
-      jv_free(args);
-  } else
+  if (jq->memstats)
+    memstats_reset(jq->memstats);
+  struct bytecode* bc = NULL;
+  struct jq_timer timer_state, *timer = NULL;
+  jv timings = jq_get_attr(jq, jv_string("JQ_DEBUG_TIMINGS"));
+  if (jv_get_kind(timings) == JV_KIND_TRUE) {
+    timer = &timer_state;
+    jq_timer_start(timer);
+    // Normally set up lazily by the first number parsed or printed
+    tsd_dtoa_context_get();
+    jq_timer_lap(timer, "dtoa init");
+  }
+  jv_free(timings);
+  args = args2obj(args);
+  jv cache_dir = jq_get_attr(jq, jv_string("JQ_CACHE_DIR"));
+  jv cache_key = jv_invalid();
+  jv deps = jv_invalid();
+  int nerrors = 0;
+  if (jv_get_kind(cache_dir) == JV_KIND_STRING) {
+    cache_key = bytecode_cache_key(jq, str, jv_copy(args));
+    bc = bytecode_cache_load(jv_copy(cache_dir), jv_copy(cache_key), jv_copy(args));
+    jq_timer_lap(timer, bc ? "cache hit" : "cache miss");
+  }
+  if (bc) {
     jv_free(args);
-  if (nerrors)
-    jq_report_error(jq, jv_string_fmt("jq: %d compile %s", nerrors, nerrors > 1 ? "errors" : "error"));
-  if (jq->bc)
-    jq->bc = optimize(jq->bc);
+  } else {
+    nerrors = load_program(jq, locations, &program,
+                           jv_is_valid(cache_key) ? &deps : NULL, timer);
+    if (nerrors == 0) {
+      nerrors = builtins_bind(jq, &program);
+      jq_timer_lap(timer, "builtins");
+      if (nerrors == 0) {
+        nerrors = block_compile(program, &bc, locations, args);
+        jq_timer_lap(timer, "compile");
+      } else
+        jv_free(args);
+    } else
+      jv_free(args);
+    if (nerrors)
+      jq_report_error(jq, jv_string_fmt("jq: %d compile %s", nerrors, nerrors > 1 ? "errors" : "error"));
+    if (bc) {
+      bc = optimize(bc);
+      jq_timer_lap(timer, "optimize");
+      if (jv_is_valid(cache_key)) {
+        bytecode_cache_store(jv_copy(cache_dir), jv_copy(cache_key), jv_copy(deps), bc);
+        jq_timer_lap(timer, "cache store");
+      }
+    }
+  }
+  jv_free(cache_dir);
+  jv_free(cache_key);
+  jv_free(deps);
+  if (bc) {
+    jq->prog = jv_mem_alloc(sizeof(*jq->prog));
+    jq->prog->refcnt = 1;
+    jq->prog->bc = bc;
+    jq->prog->attrs = jv_invalid();
+  }
   locfile_free(locations);
-  return jq->bc != NULL;
+  return jq->prog != NULL;
 }
 
 int jq_compile(jq_state *jq, const char* str) {
   return jq_compile_args(jq, str, jv_object());
 }
 
+static void bytecode_share(struct bytecode* bc) {
+  bc->constants = jv_share(bc->constants);
+  bc->debuginfo = jv_share(bc->debuginfo);
+  for (int i = 0; i < bc->nsubfunctions; i++)
+    bytecode_share(bc->subfunctions[i]);
+}
+
+/*
+ * Compile a program that can be run by many jq_states at once,
+ * including from different threads; see jq_exec_new(). Modules are
+ * found and errors reported using jq's attributes and callbacks, and
+ * the program is also left loaded in jq itself.
+ */
+jq_program *jq_program_compile(jq_state *jq, const char* str, jv args) {
+  if (!jq_compile_args(jq, str, args))
+    return NULL;
+  bytecode_share(jq->prog->bc);
+  jq->prog->attrs = jv_share(jv_copy(jq->attrs));
+  return jq_program_copy(jq->prog);
+}
+
+jq_program *jq_program_copy(jq_program *prog) {
+#ifdef __ATOMIC_ACQ_REL
+  __atomic_add_fetch(&prog->refcnt, 1, __ATOMIC_RELAXED);
+#else
+  prog->refcnt++;
+#endif
+  return prog;
+}
+
+void jq_program_free(jq_program *prog) {
+  if (prog == NULL)
+    return;
+#ifdef __ATOMIC_ACQ_REL
+  if (__atomic_sub_fetch(&prog->refcnt, 1, __ATOMIC_ACQ_REL) != 0)
+    return;
+#else
+  if (--prog->refcnt != 0)
+    return;
+#endif
+  bytecode_free(prog->bc);
+  jv_free(prog->attrs);
+  jv_mem_free(prog);
+}
+
+// A fresh execution context for prog, with the attributes prog was
+// compiled with and default callbacks.
+jq_state *jq_exec_new(jq_program *prog) {
+  jq_state *jq = jq_init();
+  if (jq == NULL)
+    return NULL;
+  jq->prog = jq_program_copy(prog);
+  if (jv_is_valid(prog->attrs))
+    jq_set_attrs(jq, jv_copy(prog->attrs));
+  return jq;
+}
+
 jv jq_get_jq_origin(jq_state *jq) {
   return jq_get_attr(jq, jv_string("JQ_ORIGIN"));
 }
@@ -1289,7 +1558,58 @@ jv jq_get_attr(jq_state *jq, jv attr) {
 }
 
 void jq_dump_disassembly(jq_state *jq, int indent) {
-  dump_disassembly(indent, jq->bc);
+  dump_disassembly(indent, jq->prog->bc);
+}
+
+void jq_set_profiling(jq_state *jq, int flags) {
+  int by_source = (flags & JQ_PROFILE_SOURCE) != 0;
+  if (jq->profile && (!flags || profile_by_source(jq->profile) != by_source)) {
+    profile_free(jq->profile);
+    jq->profile = NULL;
+  }
+  if (flags && jq->profile == NULL)
+    jq->profile = profile_new(by_source);
+  // For its allocation counts
+  if (flags)
+    jv_mem_stats_enable(1);
+}
+
+// Returns null if profiling isn't enabled
+jv jq_get_profile(jq_state *jq) {
+  if (jq->profile == NULL)
+    return jv_null();
+  return profile_report(jq->profile);
+}
+
+void jq_dump_profile(jq_state *jq, FILE *f) {
+  if (jq->profile)
+    profile_dump(profile_report(jq->profile), f);
+}
+
+// jv_mem_stats(), with allocations by opcode and builtin if enabled
+jv jq_get_memstats(jq_state *jq) {
+  if (jq->memstats == NULL)
+    return jv_mem_stats();
+  return memstats_report(jq->memstats);
+}
+
+void jq_dump_memstats(jq_state *jq, FILE *f) {
+  memstats_dump(jq_get_memstats(jq), f);
+}
+
+// Limits how much each input can use, with 0 for no limit.  When an
+// input goes over a limit, jq_next() returns an error that the program
+// couldn't catch, and then no more outputs.  Memory is counted by
+// jv_mem_stats(), which this enables.
+void jq_set_limit(jq_state *jq, jq_limit limit, double value) {
+  assert(limit >= 0 && limit < JQ_LIMIT_COUNT);
+  jq->limits[limit] = value > 0 ? value : 0;
+  if (limit == JQ_LIMIT_MEMORY && value > 0)
+    jv_mem_stats_enable(1);
+  jq->limited = 0;
+  for (int i = 0; i < JQ_LIMIT_COUNT; i++)
+    if (jq->limits[i])
+      jq->limited = 1;
 }
 
 void jq_set_input_cb(jq_state *jq, jq_input_cb cb, void *data) {
@@ -0,0 +1,34 @@
+/*
+ * Build-time helper that parses the jq-coded builtins and writes them
+ * out as a block image (see block_load_image()), so that jq doesn't
+ * need to lex and parse src/builtin.jq every time it starts.
+ */
+#include <stdio.h>
+#include "compile.h"
+#include "jq_parser.h"
+#include "locfile.h"
+
+static const char jq_builtins[] = {
+#include "src/builtin.inc"
+  '\0',
+};
+
+int main(void) {
+  jq_state *jq = jq_init();
+  block builtins;
+  struct locfile* src = locfile_init(jq, "<builtin>", jq_builtins, sizeof(jq_builtins)-1);
+  int nerrors = jq_parse_library(src, &builtins);
+  if (nerrors) {
+    locfile_free(src);
+    jq_teardown(&jq);
+    return 1;
+  }
+
+  printf("/* Generated from src/builtin.jq by gen_builtins; do not edit. */\n");
+  printf("#define JQ_BUILTIN_IMAGE 1\n\n");
+  int failed = block_dump_image(stdout, "jq_builtins_image", builtins, src);
+  block_free(builtins);
+  locfile_free(src);
+  jq_teardown(&jq);
+  return failed || fflush(stdout) != 0 || ferror(stdout);
+}
@@ -14,7 +14,21 @@ enum {
   JQ_DEBUG_TRACE_ALL = JQ_DEBUG_TRACE | JQ_DEBUG_TRACE_DETAIL,
 };
 
+enum {
+  JQ_PROFILE = 1,
+  JQ_PROFILE_SOURCE = 2,
+};
+
+/* Limits on running a program on one input, for jq_set_limit() */
+typedef enum {
+  JQ_LIMIT_MEMORY,        /* bytes of values and stack */
+  JQ_LIMIT_INSTRUCTIONS,  /* bytecode instructions executed */
+  JQ_LIMIT_TIME,          /* milliseconds of CPU time in jq_next() */
+  JQ_LIMIT_COUNT
+} jq_limit;
+
 typedef struct jq_state jq_state;
+typedef struct jq_program jq_program;
 typedef void (*jq_msg_cb)(void *, jv);
 
 jq_state *jq_init(void);
@@ -26,10 +40,21 @@ void jq_report_error(jq_state *, jv);
 int jq_compile(jq_state *, const char*);
 int jq_compile_args(jq_state *, const char*, jv);
 void jq_dump_disassembly(jq_state *, int);
+void jq_set_profiling(jq_state *, int);
+jv jq_get_profile(jq_state *);
+void jq_dump_profile(jq_state *, FILE *);
+jv jq_get_memstats(jq_state *);
+void jq_dump_memstats(jq_state *, FILE *);
+void jq_set_limit(jq_state *, jq_limit, double);
 void jq_start(jq_state *, jv value, int);
 jv jq_next(jq_state *);
 void jq_teardown(jq_state **);
 
+jq_program *jq_program_compile(jq_state *, const char*, jv);
+jq_program *jq_program_copy(jq_program *);
+void jq_program_free(jq_program *);
+jq_state *jq_exec_new(jq_program *);
+
 void jq_halt(jq_state *, jv, jv);
 int jq_halted(jq_state *);
 jv jq_get_exit_code(jq_state *);
@@ -14,6 +14,7 @@ static void run_jq_start_state_tests(void);
 static void run_jq_compile_args_tests(void);
 static void run_jq_recompile_tests(void);
 static void run_jq_exhaust_and_reuse_tests(void);
+static void run_jq_limit_tests(void);
 #ifdef HAVE_PTHREAD
 static void run_jq_pthread_tests(void);
 #endif
@@ -54,6 +55,7 @@ int jq_testsuite(jv libdirs, int verbose, int argc, char* argv[]) {
   run_jq_compile_args_tests();
   run_jq_recompile_tests();
   run_jq_exhaust_and_reuse_tests();
+  run_jq_limit_tests();
 #ifdef HAVE_PTHREAD
   run_jq_pthread_tests();
 #endif
@@ -515,6 +517,58 @@ static void run_jq_exhaust_and_reuse_tests(void) {
 }
 
 
+static void check_limit_error(jq_state *jq, const char *msg) {
+  jv r = jq_next(jq);
+  assert(!jv_is_valid(r));
+  assert(jv_invalid_has_msg(jv_copy(r)));
+  jv m = jv_invalid_get_msg(r);
+  assert(strcmp(jv_string_value(m), msg) == 0);
+  jv_free(m);
+  // Nothing more for this input, however the program was written
+  r = jq_next(jq);
+  assert(!jv_is_valid(r));
+  assert(!jv_invalid_has_msg(r));
+}
+
+// Test that jq_set_limit() stops runaway programs with an error that
+// the program can't catch, and that the next input starts afresh.
+static void run_jq_limit_tests(void) {
+  printf("Test jq limits\n");
+  jq_state *jq = jq_init();
+  assert(jq);
+
+  int compiled = jq_compile(jq, "def f: f; try f catch \"caught\", 1");
+  assert(compiled);
+  jq_set_limit(jq, JQ_LIMIT_INSTRUCTIONS, 1000);
+  jq_start(jq, jv_null(), 0);
+  check_limit_error(jq, "instruction limit of 1000 exceeded");
+  jq_start(jq, jv_null(), 0);
+  check_limit_error(jq, "instruction limit of 1000 exceeded");
+  jq_set_limit(jq, JQ_LIMIT_INSTRUCTIONS, 0);
+
+  compiled = jq_compile(jq, "[range(.)] | length");
+  assert(compiled);
+  jq_set_limit(jq, JQ_LIMIT_MEMORY, 100000);
+  jq_start(jq, jv_number(100), 0);
+  jv r = jq_next(jq);
+  assert(jv_number_value(r) == 100);
+  jv_free(r);
+  r = jq_next(jq);
+  assert(!jv_is_valid(r));
+  jq_start(jq, jv_number(1000000), 0);
+  check_limit_error(jq, "memory limit of 100000 bytes exceeded");
+  jq_set_limit(jq, JQ_LIMIT_MEMORY, 0);
+
+  compiled = jq_compile(jq, "def f: f; f");
+  assert(compiled);
+  jq_set_limit(jq, JQ_LIMIT_TIME, 50);
+  jq_start(jq, jv_null(), 0);
+  check_limit_error(jq, "time limit of 50 ms exceeded");
+
+  jq_teardown(&jq);
+}
+
+
 /// pthread regression test
 #ifdef HAVE_PTHREAD
 #define NUMBER_OF_THREADS 3
@@ -567,6 +621,49 @@ static void *test_pthread_run(void *ptr) {
     return NULL;
 }
 
+static void *test_pthread_share_run(void *ptr) {
+    jv *shared = ptr;
+    jq_state *jq = jq_init();
+    if (jq_compile(jq, ".b[1].c, (.a | length)") == 0) {
+        jq_teardown(&jq);
+        return NULL;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        jq_start(jq, jv_copy(*shared), 0);
+        jv result = jq_next(jq);
+        assert(jv_equal(result, jv_string("x")));
+        result = jq_next(jq);
+        assert(jv_equal(result, jv_number(3)));
+        result = jq_next(jq);
+        assert(!jv_is_valid(result));
+        jv_free(result);
+
+        jv copy = jv_object_set(jv_copy(*shared), jv_string("a"), jv_null());
+        assert(jv_equal(jv_object_get(copy, jv_string("a")), jv_null()));
+    }
+    jq_teardown(&jq);
+    return NULL;
+}
+
+static void *test_pthread_program_run(void *ptr) {
+    jq_program *prog = ptr;
+    jq_state *jq = jq_exec_new(prog);
+
+    for (int i = 0; i < 100; i++) {
+        jq_start(jq, jv_number(i), 0);
+        jv result = jq_next(jq);
+        assert(jv_equal(result, jv_parse("{\"n\":1}")));
+        result = jq_next(jq);
+        assert(jv_equal(result, jv_number(i + 2)));
+        result = jq_next(jq);
+        assert(!jv_is_valid(result));
+        jv_free(result);
+    }
+    jq_teardown(&jq);
+    return NULL;
+}
+
 static void run_jq_pthread_tests(void) {
     pthread_t threads[NUMBER_OF_THREADS];
     struct test_pthread_data data[NUMBER_OF_THREADS];
@@ -597,6 +694,35 @@ static void run_jq_pthread_tests(void) {
     for(a = 0; a < NUMBER_OF_THREADS; ++a) {
         assert(data[a].result == 0);
     }
+
+    // one compiled program run by all threads
+    jq_state *jq = jq_init();
+    jq_program *prog = jq_program_compile(jq, "$x, . + $two",
+                                          jv_parse("{\"x\":{\"n\":1},\"two\":2}"));
+    assert(prog != NULL);
+    jq_teardown(&jq);
+    for (a = 0; a < NUMBER_OF_THREADS; ++a) {
+        createerror = pthread_create(&threads[a], NULL, test_pthread_program_run, prog);
+        assert(createerror == 0);
+    }
+    for (a = 0; a < NUMBER_OF_THREADS; ++a)
+        pthread_join(threads[a], NULL);
+    jq_program_free(prog);
+
+    // one shared value read and copied-on-write by all threads
+    jv shared = jv_share(jv_parse("{\"a\":\"abc\",\"b\":[1,{\"c\":\"x\"}]}"));
+    for (a = 0; a < NUMBER_OF_THREADS; ++a) {
+        createerror = pthread_create(&threads[a], NULL, test_pthread_share_run, &shared);
+        assert(createerror == 0);
+    }
+    for (a = 0; a < NUMBER_OF_THREADS; ++a)
+        pthread_join(threads[a], NULL);
+    assert(jv_get_refcnt(shared) == 1);
+    assert(jv_equal(jv_object_get(jv_copy(shared), jv_string("a")), jv_string("abc")));
+    // sole owner again: writes happen in place
+    shared = jv_object_set(shared, jv_string("d"), jv_true());
+    assert(jv_get_refcnt(shared) == 1);
+    jv_free(shared);
 }
 #endif // HAVE_PTHREAD
 
@@ -610,6 +736,35 @@ static void jv_test(void) {
     assert(strcmp(jv_string_value(v), "Expected separator between values at line 1, column 9 (while parsing '{\"a':\"12\"}')") == 0);
     jv_free(v);
   }
+  /// Streaming parser events
+  {
+    static const char text[] = "{\"a\":[1,{}],\"b\":\"x\"} 2 [";
+    static const jv_parse_event expected[] = {
+      JV_PARSE_EVENT_START_OBJECT, JV_PARSE_EVENT_KEY, JV_PARSE_EVENT_START_ARRAY,
+      JV_PARSE_EVENT_VALUE, JV_PARSE_EVENT_START_OBJECT, JV_PARSE_EVENT_END_OBJECT,
+      JV_PARSE_EVENT_END_ARRAY, JV_PARSE_EVENT_KEY, JV_PARSE_EVENT_VALUE,
+      JV_PARSE_EVENT_END_OBJECT, JV_PARSE_EVENT_VALUE, JV_PARSE_EVENT_START_ARRAY,
+      JV_PARSE_EVENT_ERROR,
+    };
+    static const char *values[] = {
+      "null", "\"a\"", "null", "1", "null", "null", "null", "\"b\"", "\"x\"", "null", "2", "null",
+    };
+    jv_parser *p = jv_parser_new(JV_PARSE_EVENTS);
+    jv_parser_set_buf(p, text, strlen(text), 0);
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+      jv v;
+      assert(jv_parser_next_event(p, &v) == expected[i]);
+      if (expected[i] == JV_PARSE_EVENT_ERROR) {
+        assert(jv_invalid_has_msg(v));
+      } else {
+        assert(jv_equal(v, jv_parse(values[i])));
+      }
+    }
+    jv v;
+    assert(jv_parser_next_event(p, &v) == JV_PARSE_EVENT_NONE);
+    assert(!jv_is_valid(v));
+    jv_parser_free(p);
+  }
   /// Arrays and numbers
   {
     jv a = jv_array();
@@ -50,6 +50,12 @@
 #include "jv_unicode.h"
 #include "util.h"
 
+// Accounting for jv_mem_stats(), when it's enabled
+#define MEM_STATS_ALLOC(kind, size) \
+  do { if (jv_mem_stats_enabled) jv_mem_stats_alloc(kind, size); } while (0)
+#define MEM_STATS_FREE(kind, size) \
+  do { if (jv_mem_stats_enabled) jv_mem_stats_free(kind, size); } while (0)
+
 /*
  * Internal refcounting helpers
  */
@@ -60,20 +66,62 @@ typedef struct jv_refcnt {
 
 static const jv_refcnt JV_REFCNT_INIT = {1};
 
+/*
+ * Values reachable from a jv_share()d root carry JVP_REFCNT_SHARED in
+ * their count and are refcounted atomically; everything else stays
+ * thread-confined and uses plain increments. The bit is only ever set
+ * on a value no other thread can see yet, and only cleared once the
+ * count says we hold the sole reference, so a relaxed read of it is
+ * enough.
+ */
+#define JVP_REFCNT_SHARED 0x40000000
+#define JVP_REFCNT_MASK   (JVP_REFCNT_SHARED - 1)
+
+#ifdef __ATOMIC_ACQ_REL
+#define JVP_ATOMIC_ADD(p, n, order) __atomic_add_fetch((p), (n), (order))
+#define JVP_ATOMIC_LOAD(p, order)   __atomic_load_n((p), (order))
+#define JVP_ATOMIC_CAS(p, expected, desired) \
+  __atomic_compare_exchange_n((p), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+// Plain increments would make jv_share() a data race, not a no-op
+#error "jq needs the __atomic builtins (GCC 4.7+ or Clang) for jv_share()"
+#endif
+
+static int jvp_refcnt_is_shared(jv_refcnt* c) {
+  return (JVP_ATOMIC_LOAD(&c->count, __ATOMIC_RELAXED) & JVP_REFCNT_SHARED) != 0;
+}
+
 static void jvp_refcnt_inc(jv_refcnt* c) {
-  c->count++;
+  if (jvp_refcnt_is_shared(c))
+    JVP_ATOMIC_ADD(&c->count, 1, __ATOMIC_RELAXED);
+  else
+    c->count++;
 }
 
 static int jvp_refcnt_dec(jv_refcnt* c) {
+  if (jvp_refcnt_is_shared(c))
+    return JVP_ATOMIC_ADD(&c->count, -1, __ATOMIC_ACQ_REL) == JVP_REFCNT_SHARED;
   c->count--;
   return c->count == 0;
 }
 
 static int jvp_refcnt_unshared(jv_refcnt* c) {
+  if (jvp_refcnt_is_shared(c)) {
+    if (JVP_ATOMIC_LOAD(&c->count, __ATOMIC_ACQUIRE) != (JVP_REFCNT_SHARED | 1))
+      return 0;
+    // Sole owner: the value is thread-confined again and may be
+    // written in place, after which its children need not be shared.
+    c->count = 1;
+    return 1;
+  }
   assert(c->count > 0);
   return c->count == 1;
 }
 
+static void jvp_refcnt_set_shared(jv_refcnt* c) {
+  c->count |= JVP_REFCNT_SHARED;
+}
+
 #define KIND_MASK   0xF
 #define PFLAGS_MASK 0xF0
 #define PTYPE_MASK  0x70
@@ -554,6 +602,19 @@ static decNumber* jvp_dec_number_ptr(jv j) {
   return &(((jvp_literal_number*)j.u.ptr)->num_decimal);
 }
 
+// The size accounted for a literal number, which depends only on its
+// digits so that it's the same when it's freed
+static size_t jvp_literal_number_size(jvp_literal_number* n) {
+  return sizeof(jvp_literal_number) +
+    sizeof(decNumberUnit) * ((n->num_decimal.digits + DECDPUN - 1) / DECDPUN);
+}
+
+static jv jvp_literal_number_jv(jvp_literal_number* n) {
+  MEM_STATS_ALLOC(JV_MEM_NUMBER, jvp_literal_number_size(n));
+  jv r = {JVP_FLAGS_NUMBER_LITERAL, 0, 0, 0, {&n->refcnt}};
+  return r;
+}
+
 static jvp_literal_number* jvp_literal_number_alloc(unsigned literal_length) {
   /* The number of units needed is ceil(DECNUMDIGITS/DECDPUN)         */
   int units = ((literal_length+DECDPUN-1)/DECDPUN);
@@ -593,8 +654,7 @@ static jv jvp_literal_number_new(const char * literal) {
     return jv_number(NAN);
   }
 
-  jv r = {JVP_FLAGS_NUMBER_LITERAL, 0, 0, 0, {&n->refcnt}};
-  return r;
+  return jvp_literal_number_jv(n);
 }
 
 static double jvp_literal_number_to_double(jv j) {
@@ -640,6 +700,7 @@ static const char* jvp_literal_number_literal(jv n) {
   if (plit->literal_data == NULL) {
     int len = jvp_dec_number_ptr(n)->digits + 15 /* 14 + NUL */;
     plit->literal_data = jv_mem_alloc(len);
+    MEM_STATS_ALLOC(JV_MEM_NUMBER, len);
 
     // Preserve the actual precision as we have parsed it
     // don't do decNumberTrim(pdec);
@@ -688,8 +749,10 @@ static void jvp_number_free(jv j) {
   if (JVP_HAS_FLAGS(j, JVP_FLAGS_NUMBER_LITERAL) && jvp_refcnt_dec(j.u.ptr)) {
     jvp_literal_number* n = jvp_literal_number_ptr(j);
     if (n->literal_data) {
+      MEM_STATS_FREE(JV_MEM_NUMBER, n->num_decimal.digits + 15);
       jv_mem_free(n->literal_data);
     }
+    MEM_STATS_FREE(JV_MEM_NUMBER, jvp_literal_number_size(n));
     jv_mem_free(n);
   }
 #endif
@@ -744,8 +807,7 @@ jv jv_number_abs(jv n) {
     jvp_literal_number* m = jvp_literal_number_alloc(jvp_dec_number_ptr(n)->digits);
 
     decNumberAbs(&m->num_decimal, jvp_dec_number_ptr(n), DEC_CONTEXT());
-    jv r = {JVP_FLAGS_NUMBER_LITERAL, 0, 0, 0, {&m->refcnt}};
-    return r;
+    return jvp_literal_number_jv(m);
   }
 #endif
   return jv_number(fabs(jv_number_value(n)));
@@ -759,8 +821,7 @@ jv jv_number_negate(jv n) {
     jvp_literal_number* m = jvp_literal_number_alloc(jvp_dec_number_ptr(n)->digits);
 
     decNumberMinus(&m->num_decimal, jvp_dec_number_ptr(n), DEC_CONTEXT());
-    jv r = {JVP_FLAGS_NUMBER_LITERAL, 0, 0, 0, {&m->refcnt}};
-    return r;
+    return jvp_literal_number_jv(m);
   }
 #endif
   return jv_number(-jv_number_value(n));
@@ -831,6 +892,7 @@ static jvp_array* jvp_array_ptr(jv a) {
 
 static jvp_array* jvp_array_alloc(unsigned size) {
   jvp_array* a = jv_mem_alloc(sizeof(jvp_array) + sizeof(jv) * size);
+  MEM_STATS_ALLOC(JV_MEM_ARRAY, sizeof(jvp_array) + sizeof(jv) * size);
   a->refcnt.count = 1;
   a->length = 0;
   a->alloc_length = size;
@@ -1022,6 +1084,11 @@ jv jv_array_set(jv j, int idx, jv val) {
     jv_free(val);
     return jv_invalid_with_msg(jv_string("Array index too large"));
   }
+  if (idx > jvp_array_length(j) && !jv_mem_budget_allows((size_t)idx * sizeof(jv))) {
+    jv_free(j);
+    jv_free(val);
+    return jv_invalid_with_msg(jv_string("Array index over the memory limit"));
+  }
   // copy/free of val,j coalesced
   jv* slot = jvp_array_write(&j, idx);
   jv_free(*slot);
@@ -1053,38 +1120,77 @@ jv jv_array_slice(jv a, int start, int end) {
   return jvp_array_slice(a, start, end);
 }
 
-jv jv_array_indexes(jv a, jv b) {
-  jv res = jv_array();
-  int idx = -1;
-  int alen = jv_array_length(jv_copy(a));
-  for (int ai = 0; ai < alen; ++ai) {
-    jv_array_foreach(b, bi, belem) {
-      int equal = jv_equal(jv_array_get(jv_copy(a), ai + bi), belem);
-      if (equal < 0) {
-        jv_free(res);
-        jv_free(a);
-        jv_free(b);
-        return jv_invalid_with_msg(jv_string("Equality check too deep"));
-      }
+/*
+ * Where b occurs in a, starting at from and going forwards (or, if last,
+ * backwards), or -1 if it doesn't; -2 if comparing nests too deeply.
+ * Each place is given up at its first mismatch.  KMP would skip more,
+ * but relies on equality being transitive, which jv_equal() isn't for
+ * numbers that are only equal once converted to doubles.
+ */
+static int jvp_array_find(jv a, jv b, int from, int last) {
+  int alen = jvp_array_length(a);
+  int blen = jvp_array_length(b);
+  if (blen == 0 || blen > alen)
+    return -1;
+  if (from > alen - blen)
+    from = last ? alen - blen : alen;
+  for (int i = from; i >= 0 && i <= alen - blen; i += last ? -1 : 1) {
+    int j;
+    for (j = 0; j < blen; j++) {
+      int equal = jv_equal(jv_copy(*jvp_array_read(a, i + j)),
+                           jv_copy(*jvp_array_read(b, j)));
+      if (equal < 0)
+        return -2;
       if (!equal)
-        idx = -1;
-      else if (bi == 0 && idx == -1)
-        idx = ai;
+        break;
     }
-    if (idx > -1)
-      res = jv_array_append(res, jv_number(idx));
-    idx = -1;
+    if (j == blen)
+      return i;
+  }
+  return -1;
+}
+
+jv jv_array_indexes(jv a, jv b) {
+  jv res = jv_array();
+  int i = 0;
+  while ((i = jvp_array_find(a, b, i, 0)) >= 0) {
+    res = jv_array_append(res, jv_number(i));
+    i++;
   }
   jv_free(a);
   jv_free(b);
+  if (i == -2) {
+    jv_free(res);
+    return jv_invalid_with_msg(jv_string("Equality check too deep"));
+  }
   return res;
 }
 
+// The first (or last) of jv_array_indexes(a, b), or null
+jv jvp_array_index(jv a, jv b, int last) {
+  assert(JVP_HAS_KIND(a, JV_KIND_ARRAY));
+  assert(JVP_HAS_KIND(b, JV_KIND_ARRAY));
+  int i = jvp_array_find(a, b, last ? INT_MAX : 0, last);
+  jv_free(a);
+  jv_free(b);
+  if (i == -2)
+    return jv_invalid_with_msg(jv_string("Equality check too deep"));
+  return i < 0 ? jv_null() : jv_number(i);
+}
+
 /*
  * Strings (internal helpers)
  */
 
-#define JVP_FLAGS_STRING  JVP_MAKE_FLAGS(JV_KIND_STRING, JVP_PAYLOAD_ALLOCATED)
+enum {
+  JVP_STRING_PLAIN = 0,
+  JVP_STRING_VIEW = 1,
+  JVP_STRING_BUILDER = 2
+};
+
+#define JVP_FLAGS_STRING          JVP_MAKE_FLAGS(JV_KIND_STRING, JVP_PAYLOAD_ALLOCATED)
+#define JVP_FLAGS_STRING_VIEW     JVP_MAKE_FLAGS(JV_KIND_STRING, JVP_MAKE_PFLAGS(JVP_STRING_VIEW, 1))
+#define JVP_FLAGS_STRING_BUILDER  JVP_MAKE_FLAGS(JV_KIND_STRING, JVP_MAKE_PFLAGS(JVP_STRING_BUILDER, 1))
 
 typedef struct {
   jv_refcnt refcnt;
@@ -1096,13 +1202,59 @@ typedef struct {
   char data[];
 } jvp_string;
 
+/*
+ * A substring that shares the bytes of its parent, like an array slice.
+ * Its bytes are only NUL-terminated if the parent's NUL, or another NUL,
+ * follows them, so jv_string_value() makes a terminated copy in cstr the
+ * first time it's needed.  The fields up to alloc_length, which is
+ * always 0, are laid out as in jvp_string.
+ *
+ * A builder is a view of a buffer that only builders share, whose
+ * length is how much of it has been written.  A builder that reaches
+ * that far can be appended to in place even if it's shared, since the
+ * others don't see past their own length, which makes building a string
+ * by repeated concatenation linear when the accumulator is also held
+ * elsewhere, as in join.  As the buffer may be written past a builder's
+ * end, jv_string_value() always makes a copy of a builder.
+ */
+typedef struct {
+  jv_refcnt refcnt;
+  uint32_t hash;
+  uint32_t length_hashed;
+  uint32_t alloc_length;
+  const char* data;
+  char* cstr;
+  jv parent;
+} jvp_string_view;
+
+// Shorter substrings are copied: a view costs as much as the copy
+#define JVP_STRING_VIEW_MIN 64
+
 static jvp_string* jvp_string_ptr(jv a) {
   assert(JVP_HAS_KIND(a, JV_KIND_STRING));
   return (jvp_string*)a.u.ptr;
 }
 
+static int jvp_string_is_view(jv a) {
+  return JVP_HAS_FLAGS(a, JVP_FLAGS_STRING_VIEW) ||
+    JVP_HAS_FLAGS(a, JVP_FLAGS_STRING_BUILDER);
+}
+
+static jvp_string_view* jvp_string_view_ptr(jv a) {
+  assert(jvp_string_is_view(a));
+  return (jvp_string_view*)a.u.ptr;
+}
+
+/* The string's bytes, which for a view aren't NUL-terminated */
+const char* jvp_string_bytes(jv a) {
+  if (jvp_string_is_view(a))
+    return jvp_string_view_ptr(a)->data;
+  return jvp_string_ptr(a)->data;
+}
+
 static jvp_string* jvp_string_alloc(uint32_t size) {
   jvp_string* s = jv_mem_alloc(sizeof(jvp_string) + size + 1);
+  MEM_STATS_ALLOC(JV_MEM_STRING, sizeof(jvp_string) + size + 1);
   s->refcnt.count = 1;
   s->alloc_length = size;
   return s;
@@ -1158,15 +1310,103 @@ static jv jvp_string_empty_new(uint32_t length) {
 }
 
 
+static uint32_t jvp_string_length(jvp_string* s) {
+  return s->length_hashed >> 1;
+}
+
 static void jvp_string_free(jv js) {
   jvp_string* s = jvp_string_ptr(js);
   if (jvp_refcnt_dec(&s->refcnt)) {
+    if (jvp_string_is_view(js)) {
+      jvp_string_view* v = jvp_string_view_ptr(js);
+      jv parent = v->parent;
+      if (v->cstr) {
+        MEM_STATS_FREE(JV_MEM_STRING, jvp_string_length(s) + 1);
+        jv_mem_free(v->cstr);
+      }
+      MEM_STATS_FREE(JV_MEM_STRING, sizeof(jvp_string_view));
+      jv_mem_free(v);
+      jvp_string_free(parent);
+      return;
+    }
+    MEM_STATS_FREE(JV_MEM_STRING, sizeof(jvp_string) + s->alloc_length + 1);
     jv_mem_free(s);
   }
 }
 
-static uint32_t jvp_string_length(jvp_string* s) {
-  return s->length_hashed >> 1;
+static jv jvp_string_view_new(jv parent, const char* data, uint32_t len, int flags) {
+  jvp_string_view* v = jv_mem_alloc(sizeof(jvp_string_view));
+  MEM_STATS_ALLOC(JV_MEM_STRING, sizeof(jvp_string_view));
+  v->refcnt = JV_REFCNT_INIT;
+  v->hash = 0;
+  v->length_hashed = len << 1;
+  v->alloc_length = 0;
+  v->data = data;
+  v->cstr = NULL;
+  v->parent = parent;
+  jv r = {flags, 0, 0, 0, {&v->refcnt}};
+  return r;
+}
+
+/*
+ * The len bytes of j from byte start on, which must be whole UTF-8
+ * characters.  Long substrings share j's bytes rather than copy them.
+ */
+jv jvp_string_sub(jv j, int start, int len) {
+  assert(JVP_HAS_KIND(j, JV_KIND_STRING));
+  assert(start >= 0 && len >= 0 &&
+         (uint32_t)start + len <= jvp_string_length(jvp_string_ptr(j)));
+  if (start == 0 && (uint32_t)len == jvp_string_length(jvp_string_ptr(j)))
+    return j;
+  const char* data = jvp_string_bytes(j) + start;
+  if (len < JVP_STRING_VIEW_MIN) {
+    jv r = jvp_string_new(data, len);
+    jv_free(j);
+    return r;
+  }
+  // Views always share a plain string, never another view
+  if (!jvp_string_is_view(j))
+    return jvp_string_view_new(j, data, len, JVP_FLAGS_STRING_VIEW);
+  jv r = jvp_string_view_new(jv_copy(jvp_string_view_ptr(j)->parent), data, len,
+                             JVP_FLAGS(j));
+  jv_free(j);
+  return r;
+}
+
+static const char* jvp_string_view_cstr(jv j) {
+  jvp_string_view* v = jvp_string_view_ptr(j);
+  uint32_t len = v->length_hashed >> 1;
+  if (JVP_HAS_FLAGS(j, JVP_FLAGS_STRING_VIEW) && v->data[len] == 0)
+    return v->data;
+  char* cstr = JVP_ATOMIC_LOAD(&v->cstr, __ATOMIC_ACQUIRE);
+  if (cstr)
+    return cstr;
+  // Another thread may be doing the same, if j is shared
+  char* copy = jv_mem_alloc(len + 1);
+  memcpy(copy, v->data, len);
+  copy[len] = 0;
+  if (!JVP_ATOMIC_CAS(&v->cstr, &cstr, copy)) {
+    jv_mem_free(copy);
+    return cstr;
+  }
+  MEM_STATS_ALLOC(JV_MEM_STRING, len + 1);
+  return copy;
+}
+
+/* A plain copy of a view, for strings kept for long, such as object keys */
+static jv jvp_string_flatten(jv j) {
+  if (!jvp_string_is_view(j))
+    return j;
+  jvp_string_view* v = jvp_string_view_ptr(j);
+  uint32_t len = v->length_hashed >> 1;
+  jvp_string* s = jvp_string_alloc(len);
+  memcpy(s->data, v->data, len);
+  s->data[len] = 0;
+  s->hash = v->hash;
+  s->length_hashed = v->length_hashed;
+  jvp_string_free(j);
+  jv r = {JVP_FLAGS_STRING, 0, 0, 0, {&s->refcnt}};
+  return r;
 }
 
 static uint32_t jvp_string_remaining_space(jvp_string* s) {
@@ -1183,31 +1423,94 @@ static jv jvp_string_append(jv string, const char* data, uint32_t len) {
     return jv_invalid_with_msg(jv_string("String too long"));
   }
 
-  if (jvp_refcnt_unshared(string.u.ptr) &&
+  int unshared = jvp_refcnt_unshared(string.u.ptr);
+  if (!jvp_string_is_view(string) && unshared &&
       jvp_string_remaining_space(s) >= len) {
     // the next string fits at the end of a
     memcpy(s->data + currlen, data, len);
     s->data[currlen + len] = 0;
     s->length_hashed = (currlen + len) << 1;
     return string;
-  } else {
-    // allocate a bigger buffer and copy
-    uint32_t allocsz = (currlen + len) * 2;
-    if (allocsz < 32) allocsz = 32;
-    jvp_string* news = jvp_string_alloc(allocsz);
-    news->length_hashed = (currlen + len) << 1;
-    memcpy(news->data, s->data, currlen);
-    memcpy(news->data + currlen, data, len);
-    news->data[currlen + len] = 0;
-    jvp_string_free(string);
-    jv r = {JVP_FLAGS_STRING, 0, 0, 0, {&news->refcnt}};
-    return r;
   }
+
+  if (JVP_HAS_FLAGS(string, JVP_FLAGS_STRING_BUILDER)) {
+    jvp_string_view* v = jvp_string_view_ptr(string);
+    jvp_string* buf = jvp_string_ptr(v->parent);
+    uint32_t used = jvp_string_length(buf);
+    // Nothing else can be using the buffer past used, and as long as
+    // no other thread can see it, nothing will start to
+    if (v->data + currlen == buf->data + used &&
+        !jvp_refcnt_is_shared(&buf->refcnt) &&
+        jvp_string_remaining_space(buf) >= len) {
+      memcpy(buf->data + used, data, len);
+      buf->data[used + len] = 0;
+      buf->length_hashed = (used + len) << 1;
+      if (unshared) {
+        v->length_hashed = (currlen + len) << 1;
+        if (v->cstr) {
+          MEM_STATS_FREE(JV_MEM_STRING, currlen + 1);
+          jv_mem_free(v->cstr);
+          v->cstr = NULL;
+        }
+        return string;
+      }
+      jv r = jvp_string_view_new(jv_copy(v->parent), v->data, currlen + len,
+                                 JVP_FLAGS_STRING_BUILDER);
+      jvp_string_free(string);
+      return r;
+    }
+  }
+
+  // allocate a bigger buffer and copy
+  uint32_t allocsz = (currlen + len) * 2;
+  if (allocsz < 32) allocsz = 32;
+  jvp_string* news = jvp_string_alloc(allocsz);
+  news->length_hashed = (currlen + len) << 1;
+  memcpy(news->data, jvp_string_bytes(string), currlen);
+  memcpy(news->data + currlen, data, len);
+  news->data[currlen + len] = 0;
+  jv r = {JVP_FLAGS_STRING, 0, 0, 0, {&news->refcnt}};
+  // Appending to a string that's held elsewhere is likely to happen
+  // again to the result, so make that a builder
+  if ((!unshared || JVP_HAS_FLAGS(string, JVP_FLAGS_STRING_BUILDER)) &&
+      currlen + len >= JVP_STRING_VIEW_MIN)
+    r = jvp_string_view_new(r, news->data, currlen + len, JVP_FLAGS_STRING_BUILDER);
+  jvp_string_free(string);
+  return r;
 }
 
-static uint32_t hash_seed;
+static uint64_t hash_seed;
 static pthread_once_t hash_seed_once = PTHREAD_ONCE_INIT;
 
+/* Constants from wyhash, by Wang Yi, placed in the public domain. */
+static const uint64_t hash_secret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+static void jvp_hash_mum(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32;
+  uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static uint64_t jvp_hash_mix(uint64_t a, uint64_t b) {
+  jvp_hash_mum(&a, &b);
+  return a ^ b;
+}
+
 static void jvp_hash_seed_init(void) {
   uint32_t seed;
 #if defined(HAVE_ARC4RANDOM)
@@ -1225,74 +1528,99 @@ static void jvp_hash_seed_init(void) {
     seed = (uint32_t)getpid() ^ (uint32_t)time(NULL);
   }
 #endif
-  hash_seed = seed;
+  hash_seed = seed ^ jvp_hash_mix(seed ^ hash_secret[0], hash_secret[1]);
 }
 
-static uint32_t jvp_hash_seed(void) {
+static uint64_t jvp_hash_seed(void) {
   pthread_once(&hash_seed_once, jvp_hash_seed_init);
   return hash_seed;
 }
 
-static uint32_t rotl32 (uint32_t x, int8_t r){
-  return (x << r) | (x >> (32 - r));
+static uint64_t jvp_hash_read8(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
 }
 
-static uint32_t jvp_string_hash(jv jstr) {
-  jvp_string* str = jvp_string_ptr(jstr);
-  if (str->length_hashed & 1)
-    return str->hash;
-
-  /* The following is based on MurmurHash3.
-     MurmurHash3 was written by Austin Appleby, and is placed
-     in the public domain. */
-
-  const uint8_t* data = (const uint8_t*)str->data;
-  int len = (int)jvp_string_length(str);
-  const int nblocks = len / 4;
-
-  uint32_t h1 = jvp_hash_seed();
-
-  const uint32_t c1 = 0xcc9e2d51;
-  const uint32_t c2 = 0x1b873593;
-  const uint32_t* blocks = (const uint32_t *)(data + nblocks*4);
-
-  for(int i = -nblocks; i; i++) {
-    uint32_t k1 = blocks[i]; //FIXME: endianness/alignment
-
-    k1 *= c1;
-    k1 = rotl32(k1,15);
-    k1 *= c2;
+static uint64_t jvp_hash_read4(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
 
-    h1 ^= k1;
-    h1 = rotl32(h1,13);
-    h1 = h1*5+0xe6546b64;
+/*
+ * The following is based on wyhash (final version 4), written by Wang
+ * Yi and placed in the public domain.  Long inputs are consumed 48
+ * bytes at a time through three independent multiply chains, which the
+ * CPU overlaps.
+ *
+ * If copy is not NULL, the bytes are also copied there as they are
+ * read, so that a string can be copied and hashed in one pass.
+ */
+static uint32_t jvp_hash_bytes(const uint8_t* data, size_t len, uint8_t* copy) {
+  const uint8_t* p = data;
+  uint64_t seed = jvp_hash_seed();
+  uint64_t a, b;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (jvp_hash_read4(p) << 32) | jvp_hash_read4(p + ((len >> 3) << 2));
+      b = (jvp_hash_read4(p + len - 4) << 32) | jvp_hash_read4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+    if (copy)
+      memcpy(copy, data, len);
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = jvp_hash_mix(jvp_hash_read8(p) ^ hash_secret[1], jvp_hash_read8(p + 8) ^ seed);
+        see1 = jvp_hash_mix(jvp_hash_read8(p + 16) ^ hash_secret[2], jvp_hash_read8(p + 24) ^ see1);
+        see2 = jvp_hash_mix(jvp_hash_read8(p + 32) ^ hash_secret[3], jvp_hash_read8(p + 40) ^ see2);
+        if (copy)
+          memcpy(copy + (p - data), p, 48);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = jvp_hash_mix(jvp_hash_read8(p) ^ hash_secret[1], jvp_hash_read8(p + 8) ^ seed);
+      if (copy)
+        memcpy(copy + (p - data), p, 16);
+      i -= 16;
+      p += 16;
+    }
+    // The last 16 bytes may overlap with bytes already consumed
+    a = jvp_hash_read8(p + i - 16);
+    b = jvp_hash_read8(p + i - 8);
+    if (copy)
+      memcpy(copy + (p - data), p, i);
   }
 
-  const uint8_t* tail = (const uint8_t*)(data + nblocks*4);
-
-  uint32_t k1 = 0;
-
-  switch(len & 3) {
-  case 3: k1 ^= tail[2] << 16;
-          JQ_FALLTHROUGH;
-  case 2: k1 ^= tail[1] << 8;
-          JQ_FALLTHROUGH;
-  case 1: k1 ^= tail[0];
-          k1 *= c1; k1 = rotl32(k1,15); k1 *= c2; h1 ^= k1;
-  }
+  a ^= hash_secret[1];
+  b ^= seed;
+  jvp_hash_mum(&a, &b);
+  uint64_t h = jvp_hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+  return (uint32_t)(h ^ (h >> 32));
+}
 
-  h1 ^= len;
+static uint32_t jvp_string_hash(jv jstr) {
+  jvp_string* str = jvp_string_ptr(jstr);
+  if (str->length_hashed & 1)
+    return str->hash;
 
-  h1 ^= h1 >> 16;
-  h1 *= 0x85ebca6b;
-  h1 ^= h1 >> 13;
-  h1 *= 0xc2b2ae35;
-  h1 ^= h1 >> 16;
+  uint32_t h = jvp_hash_bytes((const uint8_t*)jvp_string_bytes(jstr), jvp_string_length(str), NULL);
 
+  str->hash = h;
   str->length_hashed |= 1;
-  str->hash = h1;
 
-  return h1;
+  return h;
 }
 
 
@@ -1302,7 +1630,23 @@ static int jvp_string_equal(jv a, jv b) {
   jvp_string* stra = jvp_string_ptr(a);
   jvp_string* strb = jvp_string_ptr(b);
   if (jvp_string_length(stra) != jvp_string_length(strb)) return 0;
-  return memcmp(stra->data, strb->data, jvp_string_length(stra)) == 0;
+  return memcmp(jvp_string_bytes(a), jvp_string_bytes(b), jvp_string_length(stra)) == 0;
+}
+
+/*
+ * Like jv_string_sized(), but valid UTF-8 input is hashed while it is
+ * copied.  Used by the parser for object keys, which are hashed as soon
+ * as they are inserted anyway.
+ */
+jv jvp_string_key_sized(const char* str, int len) {
+  if (!jvp_utf8_is_valid(str, str+len))
+    return jvp_string_copy_replace_bad(str, len);
+  jvp_string* s = jvp_string_alloc(len);
+  s->hash = jvp_hash_bytes((const uint8_t*)str, len, (uint8_t*)s->data);
+  s->length_hashed = ((uint32_t)len << 1) | 1;
+  s->data[len] = 0;
+  jv r = {JVP_FLAGS_STRING, 0, 0, 0, {&s->refcnt}};
+  return r;
 }
 
 /*
@@ -1333,7 +1677,7 @@ int jv_string_length_bytes(jv j) {
 
 int jv_string_length_codepoints(jv j) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
-  const char* i = jv_string_value(j);
+  const char* i = jvp_string_bytes(j);
   const char* end = i + jv_string_length_bytes(jv_copy(j));
   int c = 0, len = 0;
   while ((i = jvp_utf8_next(i, end, &c))) len++;
@@ -1345,8 +1689,8 @@ int jv_string_length_codepoints(jv j) {
 jv jv_string_indexes(jv j, jv k) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
   assert(JVP_HAS_KIND(k, JV_KIND_STRING));
-  const char *jstr = jv_string_value(j);
-  const char *idxstr = jv_string_value(k);
+  const char *jstr = jvp_string_bytes(j);
+  const char *idxstr = jvp_string_bytes(k);
   const char *p, *lp;
   int jlen = jv_string_length_bytes(jv_copy(j));
   int idxlen = jv_string_length_bytes(jv_copy(k));
@@ -1371,6 +1715,40 @@ jv jv_string_indexes(jv j, jv k) {
   return a;
 }
 
+// The first (or last) of jv_string_indexes(j, k), or null
+jv jvp_string_index(jv j, jv k, int last) {
+  assert(JVP_HAS_KIND(j, JV_KIND_STRING));
+  assert(JVP_HAS_KIND(k, JV_KIND_STRING));
+  const char *jstr = jvp_string_bytes(j);
+  const char *idxstr = jvp_string_bytes(k);
+  int jlen = jv_string_length_bytes(jv_copy(j));
+  int idxlen = jv_string_length_bytes(jv_copy(k));
+  const char *p = NULL;
+
+  if (idxlen == 0 || idxlen > jlen) {
+    // no match
+  } else if (!last) {
+    p = _jq_memmem(jstr, jlen, idxstr, idxlen);
+  } else {
+    for (const char *q = jstr + (jlen - idxlen); q >= jstr; q--) {
+      if (*q == *idxstr && memcmp(q, idxstr, idxlen) == 0) {
+        p = q;
+        break;
+      }
+    }
+  }
+  jv r = jv_null();
+  if (p != NULL) {
+    int n = 0;
+    for (const char *lp = jstr; lp < p; lp += jvp_utf8_decode_length(*lp))
+      n++;
+    r = jv_number(n);
+  }
+  jv_free(j);
+  jv_free(k);
+  return r;
+}
+
 jv jv_string_repeat(jv j, int n) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
   if (n < 0) {
@@ -1387,11 +1765,15 @@ jv jv_string_repeat(jv j, int n) {
     jv_free(j);
     return jv_string("");
   }
+  if (!jv_mem_budget_allows(res_len)) {
+    jv_free(j);
+    return jv_invalid_with_msg(jv_string("Repeat string result over the memory limit"));
+  }
   jv res = jv_string_empty(res_len);
-  res = jvp_string_append(res, jv_string_value(j), len);
+  res = jvp_string_append(res, jvp_string_bytes(j), len);
   for (int curr = len, grow; curr < res_len; curr += grow) {
     grow = MIN(res_len - curr, curr);
-    res = jvp_string_append(res, jv_string_value(res), grow);
+    res = jvp_string_append(res, jvp_string_bytes(res), grow);
   }
   jv_free(j);
   return res;
@@ -1400,9 +1782,9 @@ jv jv_string_repeat(jv j, int n) {
 jv jv_string_split(jv j, jv sep) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
   assert(JVP_HAS_KIND(sep, JV_KIND_STRING));
-  const char *jstr = jv_string_value(j);
+  const char *jstr = jvp_string_bytes(j);
   const char *jend = jstr + jv_string_length_bytes(jv_copy(j));
-  const char *sepstr = jv_string_value(sep);
+  const char *sepstr = jvp_string_bytes(sep);
   const char *p, *s;
   int seplen = jv_string_length_bytes(jv_copy(sep));
   jv a = jv_array();
@@ -1420,7 +1802,8 @@ jv jv_string_split(jv j, jv sep) {
       s = _jq_memmem(p, jend - p, sepstr, seplen);
       if (s == NULL)
         s = jend;
-      a = jv_array_append(a, jv_string_sized(p, s - p));
+      // Pieces of a valid string split at a valid separator are valid
+      a = jv_array_append(a, jvp_string_sub(jv_copy(j), p - jstr, s - p));
       if (!jv_is_valid(a)) break;
       // Add an empty string to denote that j ends on a sep
       if (s + seplen == jend && seplen != 0)
@@ -1434,7 +1817,7 @@ jv jv_string_split(jv j, jv sep) {
 
 jv jv_string_explode(jv j) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
-  const char* i = jv_string_value(j);
+  const char* i = jvp_string_bytes(j);
   int len = jv_string_length_bytes(jv_copy(j));
   const char* end = i + len;
   jv a = jv_array_sized(len);
@@ -1471,6 +1854,55 @@ jv jv_string_implode(jv j) {
   return s;
 }
 
+#define BYTES(b) (0x0101010101010101ULL * (b))
+
+// The 0x20 bit of each byte of w that is an ASCII letter from..from+25
+static uint64_t ascii_case_bits(uint64_t w, unsigned char from) {
+  uint64_t h = w & BYTES(0x7f);
+  uint64_t from_on = h + BYTES(0x80 - from);
+  uint64_t past = h + BYTES(0x80 - (from + 26));
+  return ((from_on ^ past) & ~w & BYTES(0x80)) >> 2;
+}
+
+/*
+ * j with the ASCII letters from..from+25 in the other case, eight bytes
+ * at a time.  Bytes of multi-byte characters are never ASCII, so the
+ * result is valid UTF-8 too; if there is nothing to change, it is j.
+ */
+jv jvp_string_ascii_case(jv j, unsigned char from) {
+  assert(JVP_HAS_KIND(j, JV_KIND_STRING));
+  const char* s = jvp_string_bytes(j);
+  uint32_t len = jvp_string_length(jvp_string_ptr(j));
+  uint32_t i = 0;
+  uint64_t w;
+
+  for (; i + 8 <= len; i += 8) {
+    memcpy(&w, s + i, 8);
+    if (ascii_case_bits(w, from))
+      break;
+  }
+  while (i < len && (unsigned char)(s[i] - from) >= 26)
+    i++;
+  if (i == len)
+    return j;
+
+  jv r = jvp_string_new(s, len);
+  char* out = jvp_string_ptr(r)->data;
+  jv_free(j);
+  for (; i + 8 <= len; i += 8) {
+    memcpy(&w, out + i, 8);
+    w ^= ascii_case_bits(w, from);
+    memcpy(out + i, &w, 8);
+  }
+  for (; i < len; i++) {
+    if ((unsigned char)(out[i] - from) < 26)
+      out[i] ^= 0x20;
+  }
+  return r;
+}
+
+#undef BYTES
+
 unsigned long jv_string_hash(jv j) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
   uint32_t hash = jvp_string_hash(j);
@@ -1480,17 +1912,18 @@ unsigned long jv_string_hash(jv j) {
 
 const char* jv_string_value(jv j) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
+  if (jvp_string_is_view(j))
+    return jvp_string_view_cstr(j);
   return jvp_string_ptr(j)->data;
 }
 
 jv jv_string_slice(jv j, int start, int end) {
   assert(JVP_HAS_KIND(j, JV_KIND_STRING));
-  const char *s = jv_string_value(j);
+  const char *s = jvp_string_bytes(j);
   int len = jv_string_length_bytes(jv_copy(j));
   int i;
   const char *p, *e;
   int c;
-  jv res;
 
   jvp_clamp_slice_params(len, &start, &end);
   assert(0 <= start && start <= end && end <= len);
@@ -1520,20 +1953,16 @@ jv jv_string_slice(jv j, int start, int end) {
     }
   }
 
-  /*
-   * NOTE: Ideally we should do here what jvp_array_slice() does instead
-   * of allocating a new string as we do!  However, we assume NUL-
-   * terminated strings all over, and in the jv API, so for now we waste
-   * memory like a drunken navy programmer.  There's probably nothing we
-   * can do about it.
-   */
-  res = jv_string_sized(p, e - p);
-  jv_free(j);
-  return res;
+  return jvp_string_sub(j, p - s, e - p);
 }
 
 jv jv_string_concat(jv a, jv b) {
-  a = jvp_string_append(a, jv_string_value(b),
+  // As in string interpolation, which starts from ""
+  if (jvp_string_length(jvp_string_ptr(a)) == 0) {
+    jv_free(a);
+    return b;
+  }
+  a = jvp_string_append(a, jvp_string_bytes(b),
                         jvp_string_length(jvp_string_ptr(b)));
   jv_free(b);
   return a;
@@ -1597,13 +2026,24 @@ jv jv_string_fmt(const char* fmt, ...) {
 
 #define JVP_FLAGS_OBJECT  JVP_MAKE_FLAGS(JV_KIND_OBJECT, JVP_PAYLOAD_ALLOCATED)
 
+/*
+ * An object of (size) slots keeps its keys and values in insertion
+ * order in (elements), followed by an open-addressed index of (size*2)
+ * buckets.  Each bucket stores the hash of its key next to the slot
+ * number, so a lookup linearly probes one dense array and only touches
+ * a slot when the full hash matches.  Deleted slots are left empty
+ * (string is null) so that the remaining keys keep their order.
+ */
 struct object_slot {
-  int next; /* next slot with same hash, for collisions */
-  uint32_t hash;
   jv string;
   jv value;
 };
 
+struct object_bucket {
+  uint32_t hash;
+  int slot; /* -1 if the bucket is empty */
+};
+
 typedef struct {
   jv_refcnt refcnt;
   int next_free;
@@ -1611,6 +2051,12 @@ typedef struct {
 } jvp_object;
 
 
+static size_t jvp_object_alloc_size(int size) {
+  return sizeof(jvp_object) +
+    sizeof(struct object_slot) * size +
+    sizeof(struct object_bucket) * (size * 2);
+}
+
 /* warning: nontrivial justification of alignment */
 static jv jvp_object_new(int size) {
   // Allocates an object of (size) slots and (size*2) hash buckets.
@@ -1618,20 +2064,18 @@ static jv jvp_object_new(int size) {
   // size must be a power of two
   assert(size > 0 && (size & (size - 1)) == 0);
 
-  jvp_object* obj = jv_mem_alloc(sizeof(jvp_object) +
-                                 sizeof(struct object_slot) * size +
-                                 sizeof(int) * (size * 2));
+  jvp_object* obj = jv_mem_alloc(jvp_object_alloc_size(size));
+  MEM_STATS_ALLOC(JV_MEM_OBJECT, jvp_object_alloc_size(size));
   obj->refcnt.count = 1;
   for (int i=0; i<size; i++) {
-    obj->elements[i].next = i - 1;
     obj->elements[i].string = JV_NULL;
-    obj->elements[i].hash = 0;
     obj->elements[i].value = JV_NULL;
   }
   obj->next_free = 0;
-  int* hashbuckets = (int*)(&obj->elements[size]);
+  struct object_bucket* buckets = (struct object_bucket*)(&obj->elements[size]);
   for (int i=0; i<size*2; i++) {
-    hashbuckets[i] = -1;
+    buckets[i].hash = 0;
+    buckets[i].slot = -1;
   }
   jv r = {JVP_FLAGS_OBJECT, 0, 0, size, {&obj->refcnt}};
   return r;
@@ -1652,12 +2096,8 @@ static int jvp_object_size(jv o) {
   return o.size;
 }
 
-static int* jvp_object_buckets(jv o) {
-  return (int*)(&jvp_object_ptr(o)->elements[o.size]);
-}
-
-static int* jvp_object_find_bucket(jv object, jv key) {
-  return jvp_object_buckets(object) + (jvp_object_mask(object) & jvp_string_hash(key));
+static struct object_bucket* jvp_object_buckets(jv o) {
+  return (struct object_bucket*)(&jvp_object_ptr(o)->elements[o.size]);
 }
 
 static struct object_slot* jvp_object_get_slot(jv object, int slot) {
@@ -1666,39 +2106,42 @@ static struct object_slot* jvp_object_get_slot(jv object, int slot) {
   else return &jvp_object_ptr(object)->elements[slot];
 }
 
-static struct object_slot* jvp_object_next_slot(jv object, struct object_slot* slot) {
-  return jvp_object_get_slot(object, slot->next);
-}
-
-static struct object_slot* jvp_object_find_slot(jv object, jv keystr, int* bucket) {
-  uint32_t hash = jvp_string_hash(keystr);
-  for (struct object_slot* curr = jvp_object_get_slot(object, *bucket);
-       curr;
-       curr = jvp_object_next_slot(object, curr)) {
-    if (curr->hash == hash && jvp_string_equal(keystr, curr->string)) {
+/*
+ * Returns the bucket of keystr, or the empty bucket where it would be
+ * inserted.  There are twice as many buckets as slots, so the probe
+ * always ends.
+ */
+static struct object_bucket* jvp_object_find_bucket(jv object, jv keystr, uint32_t hash) {
+  struct object_bucket* buckets = jvp_object_buckets(object);
+  uint32_t mask = jvp_object_mask(object);
+  for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+    struct object_bucket* curr = &buckets[i];
+    if (curr->slot == -1)
+      return curr;
+    if (curr->hash == hash &&
+        jvp_string_equal(keystr, jvp_object_get_slot(object, curr->slot)->string))
       return curr;
-    }
   }
-  return 0;
 }
 
-static struct object_slot* jvp_object_add_slot(jv object, jv key, int* bucket) {
+static struct object_slot* jvp_object_add_slot(jv object, jv key, uint32_t hash,
+                                               struct object_bucket* bucket) {
   jvp_object* o = jvp_object_ptr(object);
   int newslot_idx = o->next_free;
   if (newslot_idx == jvp_object_size(object)) return 0;
+  assert(bucket->slot == -1);
   struct object_slot* newslot = jvp_object_get_slot(object, newslot_idx);
   o->next_free++;
-  newslot->next = *bucket;
-  *bucket = newslot_idx;
-  newslot->hash = jvp_string_hash(key);
+  bucket->hash = hash;
+  bucket->slot = newslot_idx;
   newslot->string = key;
   return newslot;
 }
 
 static jv* jvp_object_read(jv object, jv key) {
   assert(JVP_HAS_KIND(key, JV_KIND_STRING));
-  int* bucket = jvp_object_find_bucket(object, key);
-  struct object_slot* slot = jvp_object_find_slot(object, key, bucket);
+  struct object_bucket* bucket = jvp_object_find_bucket(object, key, jvp_string_hash(key));
+  struct object_slot* slot = jvp_object_get_slot(object, bucket->slot);
   if (slot == 0) return 0;
   else return &slot->value;
 }
@@ -1714,13 +2157,15 @@ static int jvp_object_rehash(jv *objectp) {
   for (int i=0; i<size; i++) {
     struct object_slot* slot = jvp_object_get_slot(object, i);
     if (jv_get_kind(slot->string) == JV_KIND_NULL) continue;
-    int* new_bucket = jvp_object_find_bucket(new_object, slot->string);
-    assert(!jvp_object_find_slot(new_object, slot->string, new_bucket));
-    struct object_slot* new_slot = jvp_object_add_slot(new_object, slot->string, new_bucket);
+    uint32_t hash = jvp_string_hash(slot->string);
+    struct object_bucket* new_bucket = jvp_object_find_bucket(new_object, slot->string, hash);
+    assert(new_bucket->slot == -1);
+    struct object_slot* new_slot = jvp_object_add_slot(new_object, slot->string, hash, new_bucket);
     assert(new_slot);
     new_slot->value = slot->value;
   }
   // references are transported, just drop the old table
+  MEM_STATS_FREE(JV_MEM_OBJECT, jvp_object_alloc_size(size));
   jv_mem_free(jvp_object_ptr(object));
   *objectp = new_object;
   return 1;
@@ -1736,16 +2181,15 @@ static jv jvp_object_unshare(jv object) {
   for (int i=0; i<jvp_object_size(new_object); i++) {
     struct object_slot* old_slot = jvp_object_get_slot(object, i);
     struct object_slot* new_slot = jvp_object_get_slot(new_object, i);
-    *new_slot = *old_slot;
     if (jv_get_kind(old_slot->string) != JV_KIND_NULL) {
       new_slot->string = jv_copy(old_slot->string);
       new_slot->value = jv_copy(old_slot->value);
     }
   }
 
-  int* old_buckets = jvp_object_buckets(object);
-  int* new_buckets = jvp_object_buckets(new_object);
-  memcpy(new_buckets, old_buckets, sizeof(int) * jvp_object_size(new_object)*2);
+  struct object_bucket* old_buckets = jvp_object_buckets(object);
+  struct object_bucket* new_buckets = jvp_object_buckets(new_object);
+  memcpy(new_buckets, old_buckets, sizeof(struct object_bucket) * jvp_object_size(new_object)*2);
 
   jv_free(object);
   assert(jvp_refcnt_unshared(new_object.u.ptr));
@@ -1754,15 +2198,16 @@ static jv jvp_object_unshare(jv object) {
 
 static int jvp_object_write(jv* object, jv key, jv **valpp) {
   *object = jvp_object_unshare(*object);
-  int* bucket = jvp_object_find_bucket(*object, key);
-  struct object_slot* slot = jvp_object_find_slot(*object, key, bucket);
-  if (slot) {
+  uint32_t hash = jvp_string_hash(key);
+  struct object_bucket* bucket = jvp_object_find_bucket(*object, key, hash);
+  if (bucket->slot != -1) {
     // already has the key
     jvp_string_free(key);
-    *valpp = &slot->value;
+    *valpp = &jvp_object_get_slot(*object, bucket->slot)->value;
     return 1;
   }
-  slot = jvp_object_add_slot(*object, key, bucket);
+  key = jvp_string_flatten(key);
+  struct object_slot* slot = jvp_object_add_slot(*object, key, hash, bucket);
   if (slot) {
     slot->value = jv_invalid();
   } else {
@@ -1771,9 +2216,8 @@ static int jvp_object_write(jv* object, jv key, jv **valpp) {
       *valpp = NULL;
       return 0;
     }
-    bucket = jvp_object_find_bucket(*object, key);
-    assert(!jvp_object_find_slot(*object, key, bucket));
-    slot = jvp_object_add_slot(*object, key, bucket);
+    bucket = jvp_object_find_bucket(*object, key, hash);
+    slot = jvp_object_add_slot(*object, key, hash, bucket);
     assert(slot);
     slot->value = jv_invalid();
   }
@@ -1784,22 +2228,30 @@ static int jvp_object_write(jv* object, jv key, jv **valpp) {
 static int jvp_object_delete(jv* object, jv key) {
   assert(JVP_HAS_KIND(key, JV_KIND_STRING));
   *object = jvp_object_unshare(*object);
-  int* bucket = jvp_object_find_bucket(*object, key);
-  int* prev_ptr = bucket;
-  uint32_t hash = jvp_string_hash(key);
-  for (struct object_slot* curr = jvp_object_get_slot(*object, *bucket);
-       curr;
-       curr = jvp_object_next_slot(*object, curr)) {
-    if (hash == curr->hash && jvp_string_equal(key, curr->string)) {
-      *prev_ptr = curr->next;
-      jvp_string_free(curr->string);
-      curr->string = JV_NULL;
-      jv_free(curr->value);
-      return 1;
+  struct object_bucket* buckets = jvp_object_buckets(*object);
+  uint32_t mask = jvp_object_mask(*object);
+  struct object_bucket* bucket = jvp_object_find_bucket(*object, key, jvp_string_hash(key));
+  if (bucket->slot == -1)
+    return 0;
+
+  struct object_slot* slot = jvp_object_get_slot(*object, bucket->slot);
+  jvp_string_free(slot->string);
+  slot->string = JV_NULL;
+  jv_free(slot->value);
+  slot->value = JV_NULL;
+
+  // Shift the following buckets of the probe sequence back into the
+  // hole, so that lookups never need tombstones.
+  uint32_t hole = bucket - buckets;
+  for (uint32_t i = (hole + 1) & mask; buckets[i].slot != -1; i = (i + 1) & mask) {
+    uint32_t home = buckets[i].hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      buckets[hole] = buckets[i];
+      hole = i;
     }
-    prev_ptr = &curr->next;
   }
-  return 0;
+  buckets[hole].slot = -1;
+  return 1;
 }
 
 static int jvp_object_length(jv object) {
@@ -2025,6 +2477,7 @@ void jv_free(jv j) {
           }
           for (int i = 0; i < arr->length; i++)
             pending[len++] = arr->elements[i];
+          MEM_STATS_FREE(JV_MEM_ARRAY, sizeof(jvp_array) + sizeof(jv) * arr->alloc_length);
           jv_mem_free(arr);
         }
         break;
@@ -2042,6 +2495,7 @@ void jv_free(jv j) {
               pending[len++] = slot->value;
             }
           }
+          MEM_STATS_FREE(JV_MEM_OBJECT, jvp_object_alloc_size(sz));
           jv_mem_free(jvp_object_ptr(j));
         }
         break;
@@ -2068,9 +2522,74 @@ void jv_free(jv j) {
   jv_mem_free(pending);
 }
 
+/*
+ * Mark everything reachable from j as shared, so that copies and frees
+ * from other threads use atomic refcounts. Lazily computed caches
+ * (string hashes, number conversions) are filled in here, as they
+ * would otherwise be written on first use by whichever thread gets
+ * there first. Already shared subtrees are not revisited.
+ */
+jv jv_share(jv j) {
+  jv* pending = NULL;
+  size_t len = 0, cap = 0;
+  jv x = j;
+  while (1) {
+    if (JVP_IS_ALLOCATED(x) && !jvp_refcnt_is_shared(x.u.ptr)) {
+      int n = 0;
+      switch (JVP_KIND(x)) {
+        case JV_KIND_ARRAY:
+          n = jvp_array_ptr(x)->length;
+          break;
+        case JV_KIND_OBJECT:
+          n = 2 * jvp_object_size(x);
+          break;
+        case JV_KIND_INVALID:
+          n = 1;
+          break;
+        case JV_KIND_STRING:
+          jvp_string_hash(x);
+          n = jvp_string_is_view(x);
+          break;
+        case JV_KIND_NUMBER:
+          jv_number_value(x);
+#ifdef USE_DECNUM
+          jv_number_get_literal(x);
+#endif
+          break;
+      }
+      if (len + n > cap) {
+        cap = (len + n) * 2;
+        pending = jv_mem_realloc(pending, cap * sizeof(jv));
+      }
+      if (JVP_HAS_KIND(x, JV_KIND_ARRAY)) {
+        jvp_array* arr = jvp_array_ptr(x);
+        for (int i = 0; i < n; i++)
+          pending[len++] = arr->elements[i];
+      } else if (JVP_HAS_KIND(x, JV_KIND_OBJECT)) {
+        for (int i = 0; i < n / 2; i++) {
+          struct object_slot* slot = jvp_object_get_slot(x, i);
+          if (jv_get_kind(slot->string) != JV_KIND_NULL) {
+            pending[len++] = slot->string;
+            pending[len++] = slot->value;
+          }
+        }
+      } else if (JVP_HAS_KIND(x, JV_KIND_INVALID)) {
+        pending[len++] = ((jvp_invalid*)x.u.ptr)->errmsg;
+      } else if (n) {
+        pending[len++] = jvp_string_view_ptr(x)->parent;
+      }
+      jvp_refcnt_set_shared(x.u.ptr);
+    }
+    if (len == 0) break;
+    x = pending[--len];
+  }
+  jv_mem_free(pending);
+  return j;
+}
+
 int jv_get_refcnt(jv j) {
   if (JVP_IS_ALLOCATED(j)) {
-    return j.u.ptr->count;
+    return j.u.ptr->count & JVP_REFCNT_MASK;
   } else {
     return 1;
   }
@@ -2166,8 +2685,8 @@ static int jvp_contains(jv a, jv b, int depth) {
   } else if (JVP_HAS_KIND(a, JV_KIND_STRING)) {
     int b_len = jv_string_length_bytes(jv_copy(b));
     if (b_len != 0) {
-      r = _jq_memmem(jv_string_value(a), jv_string_length_bytes(jv_copy(a)),
-                     jv_string_value(b), b_len) != 0;
+      r = _jq_memmem(jvp_string_bytes(a), jv_string_length_bytes(jv_copy(a)),
+                     jvp_string_bytes(b), b_len) != 0;
     } else {
       r = 1;
     }
@@ -53,6 +53,9 @@ static int jv_is_valid(jv x) { return jv_get_kind(x) != JV_KIND_INVALID; }
 
 jv jv_copy(jv);
 void jv_free(jv);
+/* Make a value safe to copy, read and free from several threads at
+   once. Modifying a shared value still copies it first. */
+jv jv_share(jv);
 
 int jv_get_refcnt(jv);
 
@@ -240,6 +243,7 @@ enum {
   JV_PARSE_SEQ              = 1,
   JV_PARSE_STREAMING        = 2,
   JV_PARSE_STREAM_ERRORS    = 4,
+  JV_PARSE_EVENTS           = 8,  // implies JV_PARSE_STREAMING
 };
 
 jv jv_parse(const char* string);
@@ -249,6 +253,10 @@ jv jv_parse_custom_flags(const char* string, int flags);
 typedef void (*jv_nomem_handler_f)(void *);
 void jv_nomem_handler(jv_nomem_handler_f, void *);
 
+/* Must be enabled before any values are allocated */
+void jv_mem_stats_enable(int);
+jv jv_mem_stats(void);
+
 jv jv_load_file(const char *, int);
 
 typedef struct jv_parser jv_parser;
@@ -258,6 +266,34 @@ int jv_parser_remaining(jv_parser*);
 jv jv_parser_next(jv_parser*);
 void jv_parser_free(jv_parser*);
 
+/*
+ * With JV_PARSE_EVENTS, jv_parser_next_event() reports the structure of
+ * the input one event at a time, without building a path for each one as
+ * JV_PARSE_STREAMING does.  *value is the key for JV_PARSE_EVENT_KEY, the
+ * scalar for JV_PARSE_EVENT_VALUE, the error for JV_PARSE_EVENT_ERROR,
+ * invalid for JV_PARSE_EVENT_NONE (more input is needed, or there is no
+ * more), and null otherwise.  Array indexes are left to the caller to
+ * count.
+ */
+typedef enum {
+  JV_PARSE_EVENT_NONE,
+  JV_PARSE_EVENT_ERROR,
+  JV_PARSE_EVENT_START_ARRAY,
+  JV_PARSE_EVENT_START_OBJECT,
+  JV_PARSE_EVENT_KEY,
+  JV_PARSE_EVENT_VALUE,
+  JV_PARSE_EVENT_END_ARRAY,
+  JV_PARSE_EVENT_END_OBJECT,
+} jv_parse_event;
+jv_parse_event jv_parser_next_event(jv_parser*, jv*);
+
+/*
+ * Makes a JV_PARSE_STREAMING parser output the values whose paths match
+ * the given array of object keys and array indexes, where null matches
+ * any key or index, and skip the rest of the input.
+ */
+void jv_parser_set_stream_path(jv_parser*, jv);
+
 jv jv_get(jv, jv);
 jv jv_set(jv, jv, jv);
 jv jv_has(jv, jv);
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "jv.h"
+#include "jv_alloc.h"
 
 struct nomem_handler {
     jv_nomem_handler_f handler;
@@ -137,8 +138,56 @@ static void memory_exhausted(void) {
 #endif /* HAVE_PTHREAD_KEY_CREATE */
 #endif /* USE_TLS */
 
+// Only read by --debug-timings, the profiler and the benchmarks, so
+// don't bother synchronizing threads that lack TLS.  Counted along with
+// the stats below, to keep it off the allocation path otherwise.
+#ifdef HAVE___THREAD
+static __thread size_t alloc_count;
+#else
+static size_t alloc_count;
+#endif
+
+int jv_mem_stats_enabled;
+
+#define COUNT_ALLOC() do { if (jv_mem_stats_enabled) alloc_count++; } while (0)
+
+size_t jv_mem_alloc_count(void) {
+  return alloc_count;
+}
+
+struct mem_budget {
+  int64_t ceiling;
+  int refused;
+};
+
+#ifdef HAVE___THREAD
+static __thread struct jv_mem_stats mem_stats[JV_MEM_KINDS];
+static __thread struct mem_budget mem_budget;
+#else
+static struct jv_mem_stats mem_stats[JV_MEM_KINDS];
+static struct mem_budget mem_budget;
+#endif
+
+void jv_mem_budget(int64_t ceiling) {
+  mem_budget.ceiling = ceiling;
+  mem_budget.refused = 0;
+}
+
+int jv_mem_budget_allows(size_t sz) {
+  if (mem_budget.ceiling &&
+      (uint64_t)mem_stats[JV_MEM_TOTAL].live_bytes + sz > (uint64_t)mem_budget.ceiling) {
+    mem_budget.refused = 1;
+    return 0;
+  }
+  return 1;
+}
+
+int jv_mem_budget_refused(void) {
+  return mem_budget.refused;
+}
 
 void* jv_mem_alloc(size_t sz) {
+  COUNT_ALLOC();
   void* p = malloc(sz);
   if (!p) {
     memory_exhausted();
@@ -147,11 +196,13 @@ void* jv_mem_alloc(size_t sz) {
 }
 
 void* jv_mem_alloc_unguarded(size_t sz) {
+  COUNT_ALLOC();
   return malloc(sz);
 }
 
 void* jv_mem_calloc(size_t nemb, size_t sz) {
   assert(nemb > 0 && sz > 0);
+  COUNT_ALLOC();
   void* p = calloc(nemb, sz);
   if (!p) {
     memory_exhausted();
@@ -161,10 +212,12 @@ void* jv_mem_calloc(size_t nemb, size_t sz) {
 
 void* jv_mem_calloc_unguarded(size_t nemb, size_t sz) {
   assert(nemb > 0 && sz > 0);
+  COUNT_ALLOC();
   return calloc(nemb, sz);
 }
 
 char* jv_mem_strdup(const char *s) {
+  COUNT_ALLOC();
   char *p = strdup(s);
   if (!p) {
     memory_exhausted();
@@ -173,6 +226,7 @@ char* jv_mem_strdup(const char *s) {
 }
 
 char* jv_mem_strdup_unguarded(const char *s) {
+  COUNT_ALLOC();
   return strdup(s);
 }
 
@@ -181,9 +235,62 @@ void jv_mem_free(void* p) {
 }
 
 void* jv_mem_realloc(void* p, size_t sz) {
+  COUNT_ALLOC();
   p = realloc(p, sz);
   if (!p) {
     memory_exhausted();
   }
   return p;
 }
+
+void jv_mem_stats_enable(int enabled) {
+  jv_mem_stats_enabled = enabled;
+}
+
+static void mem_stats_add(struct jv_mem_stats *s, size_t size) {
+  s->allocs++;
+  s->alloc_bytes += size;
+  s->live++;
+  s->live_bytes += size;
+  if (s->live > s->peak)
+    s->peak = s->live;
+  if (s->live_bytes > s->peak_bytes)
+    s->peak_bytes = s->live_bytes;
+}
+
+void jv_mem_stats_alloc(int kind, size_t size) {
+  assert(kind >= 0 && kind < JV_MEM_TOTAL);
+  mem_stats_add(&mem_stats[kind], size);
+  mem_stats_add(&mem_stats[JV_MEM_TOTAL], size);
+}
+
+void jv_mem_stats_free(int kind, size_t size) {
+  assert(kind >= 0 && kind < JV_MEM_TOTAL);
+  mem_stats[kind].live--;
+  mem_stats[kind].live_bytes -= size;
+  mem_stats[JV_MEM_TOTAL].live--;
+  mem_stats[JV_MEM_TOTAL].live_bytes -= size;
+}
+
+// Returns this thread's counters, indexed by JV_MEM_*
+const struct jv_mem_stats *jv_mem_stats_get(void) {
+  return mem_stats;
+}
+
+jv jv_mem_stats(void) {
+  static const char *names[JV_MEM_KINDS] = {"string", "array", "object", "number", "total"};
+  jv ret = jv_object_set(jv_object(), jv_string("enabled"), jv_bool(jv_mem_stats_enabled));
+  // Read the counters before building the result changes them
+  struct jv_mem_stats s[JV_MEM_KINDS];
+  memcpy(s, mem_stats, sizeof(s));
+  for (int i = 0; i < JV_MEM_KINDS; i++) {
+    ret = jv_object_set(ret, jv_string(names[i]),
+                        JV_OBJECT(jv_string("live"), jv_number(s[i].live),
+                                  jv_string("live_bytes"), jv_number(s[i].live_bytes),
+                                  jv_string("peak"), jv_number(s[i].peak),
+                                  jv_string("peak_bytes"), jv_number(s[i].peak_bytes),
+                                  jv_string("allocs"), jv_number(s[i].allocs),
+                                  jv_string("alloc_bytes"), jv_number(s[i].alloc_bytes)));
+  }
+  return ret;
+}
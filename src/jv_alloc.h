@@ -2,6 +2,7 @@
 #define JV_ALLOC_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 void* jv_mem_alloc(size_t);
 void* jv_mem_alloc_unguarded(size_t);
@@ -11,5 +12,44 @@ char* jv_mem_strdup(const char *);
 char* jv_mem_strdup_unguarded(const char *);
 void jv_mem_free(void*);
 __attribute__((warn_unused_result)) void* jv_mem_realloc(void*, size_t);
+size_t jv_mem_alloc_count(void);    // while jv_mem_stats_enable() is on
+
+/*
+ * Optional accounting of the memory held by jv values, by kind, turned
+ * on by jv_mem_stats_enable().  Counters are per thread.
+ */
+enum {
+  JV_MEM_STRING,
+  JV_MEM_ARRAY,
+  JV_MEM_OBJECT,
+  JV_MEM_NUMBER,     // literal numbers; other numbers aren't allocated
+  JV_MEM_TOTAL,
+  JV_MEM_KINDS
+};
+
+struct jv_mem_stats {
+  int64_t live;
+  int64_t live_bytes;
+  int64_t peak;
+  int64_t peak_bytes;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+};
+
+extern int jv_mem_stats_enabled;
+void jv_mem_stats_alloc(int, size_t);
+void jv_mem_stats_free(int, size_t);
+const struct jv_mem_stats *jv_mem_stats_get(void);
+
+/*
+ * An optional ceiling on this thread's live bytes as counted above.  It
+ * never stops an allocation: code making one sized by its input, rather
+ * than grown step by step, asks jv_mem_budget_allows() first and fails
+ * instead.  A refusal is remembered until the next jv_mem_budget() call,
+ * so that the caller's caller can tell even if the failure is caught.
+ */
+void jv_mem_budget(int64_t);
+int jv_mem_budget_allows(size_t);
+int jv_mem_budget_refused(void);
 
 #endif
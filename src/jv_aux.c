@@ -564,7 +564,7 @@ static int string_cmp(const void* pa, const void* pb){
   int lena = jv_string_length_bytes(jv_copy(*a));
   int lenb = jv_string_length_bytes(jv_copy(*b));
   int minlen = lena < lenb ? lena : lenb;
-  int r = memcmp(jv_string_value(*a), jv_string_value(*b), minlen);
+  int r = memcmp(jvp_string_bytes(*a), jvp_string_bytes(*b), minlen);
   if (r == 0) r = lena - lenb;
   return r;
 }
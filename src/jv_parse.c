@@ -8,6 +8,7 @@
 #include "jv_unicode.h"
 #include "jv_alloc.h"
 #include "jv_dtoa.h"
+#include "jv_private.h"
 
 typedef const char* presult;
 
@@ -15,6 +16,9 @@ typedef const char* presult;
 #define MAX_PARSING_DEPTH (10000)
 #endif
 
+// The most events one token can produce, and then some
+#define MAX_STREAM_EVENTS (4)
+
 #define TRY(x) do {presult msg__ = (x); if (msg__) return msg__; } while(0)
 #ifdef __GNUC__
 #define pfunc __attribute__((warn_unused_result)) presult
@@ -46,7 +50,17 @@ struct jv_parser {
   int stacklen;                // both (optimization; it's really pathlen for streaming)
   jv path;                     // streamer
   enum last_seen last_seen;    // streamer
-  jv output;                   // streamer
+  struct {                     // streamer: events not yet returned
+    jv_parse_event kind;
+    jv value;                  // for jv_parser_next(), the output
+  } events[MAX_STREAM_EVENTS];
+  int eventpos, nevents;       // streamer
+  jv_parse_event last_event;   // streamer: kind of the last one returned
+  jv stream_path;              // streamer: paths of the values to output
+  jv* build;                   // streamer: containers of the value being output
+  int buildpos, buildlen;      // streamer
+  int skipping;                // streamer: depth of a container being skipped
+  jv skipped_string;           // streamer: stands in for its strings
   jv next;                     // both
 
   char* tokenbuf;
@@ -78,7 +92,13 @@ static void parser_init(struct jv_parser* p, int flags) {
   p->stack = 0;
   p->stacklen = p->stackpos = 0;
   p->last_seen = JV_LAST_NONE;
-  p->output = jv_invalid();
+  p->eventpos = p->nevents = 0;
+  p->last_event = JV_PARSE_EVENT_NONE;
+  p->stream_path = jv_invalid();
+  p->build = 0;
+  p->buildpos = p->buildlen = 0;
+  p->skipping = 0;
+  p->skipped_string = jv_invalid();
   p->next = jv_invalid();
   p->tokenlen = 256;
   p->tokenbuf = jv_mem_alloc(p->tokenlen);
@@ -104,8 +124,12 @@ static void parser_reset(struct jv_parser* p) {
     p->stacklen = 0;
   }
   p->last_seen = JV_LAST_NONE;
-  jv_free(p->output);
-  p->output = jv_invalid();
+  for (; p->nevents > 0; p->nevents--, p->eventpos = (p->eventpos + 1) % MAX_STREAM_EVENTS)
+    jv_free(p->events[p->eventpos].value);
+  p->eventpos = 0;
+  for (; p->buildpos > 0; p->buildpos--)
+    jv_free(p->build[p->buildpos - 1]);
+  p->skipping = 0;
   jv_free(p->next);
   p->next = jv_invalid();
   for (int i=0; i<p->stackpos; i++)
@@ -118,7 +142,9 @@ static void parser_reset(struct jv_parser* p) {
 static void parser_free(struct jv_parser* p) {
   parser_reset(p);
   jv_free(p->path);
-  jv_free(p->output);
+  jv_free(p->stream_path);
+  jv_free(p->skipped_string);
+  jv_mem_free(p->build);
   jv_mem_free(p->stack);
   jv_mem_free(p->tokenbuf);
   jvp_dtoa_context_free(&p->dtoa);
@@ -240,6 +266,150 @@ static pfunc parse_token(struct jv_parser* p, char ch) {
   return 0;
 }
 
+/*
+ * The streamer reports what it finds as events: the start of an array or
+ * object, an object key, a scalar (or, in jv_parser_next() outputs, an
+ * empty array or object), and the end of an array or object.  Events are
+ * queued for jv_parser_next_event() as they are, without allocating
+ * anything.  For jv_parser_next() each one is turned into the [path, leaf]
+ * or [path] output of --stream right away, while p->path still says where
+ * it happened; starts and keys have no output of their own.
+ */
+static void stream_queue(struct jv_parser* p, jv_parse_event kind, jv v) {
+  assert(p->nevents < MAX_STREAM_EVENTS);
+  int i = (p->eventpos + p->nevents++) % MAX_STREAM_EVENTS;
+  p->events[i].kind = kind;
+  p->events[i].value = v;
+}
+
+static void stream_select(struct jv_parser*, jv_parse_event, jv);
+
+static void stream_emit(struct jv_parser* p, jv_parse_event kind, jv v) {
+  if (jv_is_valid(p->stream_path)) {
+    stream_select(p, kind, v);
+    return;
+  }
+  if (!(p->flags & JV_PARSE_EVENTS)) {
+    switch (kind) {
+    case JV_PARSE_EVENT_VALUE:
+      v = JV_ARRAY(jv_copy(p->path), v);
+      break;
+    case JV_PARSE_EVENT_END_ARRAY:
+    case JV_PARSE_EVENT_END_OBJECT:
+      if (p->last_seen == JV_LAST_OPEN_ARRAY || p->last_seen == JV_LAST_OPEN_OBJECT) {
+        // Empty arrays and objects are leaves
+        v = JV_ARRAY(jv_array_slice(jv_copy(p->path), 0, p->stacklen - 1),
+                     kind == JV_PARSE_EVENT_END_ARRAY ? jv_array() : jv_object());
+      } else {
+        v = JV_ARRAY(jv_copy(p->path));
+      }
+      break;
+    default:
+      jv_free(v);
+      return;
+    }
+  }
+  stream_queue(p, kind, v);
+}
+
+/*
+ * With a stream path, the streamer outputs the values at the paths that
+ * match it instead of events, building each one from the events inside
+ * it.  Containers that can't hold a match are skipped: their events are
+ * dropped as they come, and found_string() and check_literal() don't
+ * make values for what's in them.  p->path says where the value that an
+ * event belongs to is: for a start or end event it includes the key or
+ * index of the container's current element, for a value event it ends
+ * with the value's own key or index.
+ */
+static int stream_path_matches(struct jv_parser* p, int i) {
+  jv want = jv_array_get(jv_copy(p->stream_path), i);
+  jv have = jv_array_get(jv_copy(p->path), i);
+  int r = jv_get_kind(want) == JV_KIND_NULL || jv_equal(jv_copy(want), jv_copy(have));
+  jv_free(want);
+  jv_free(have);
+  return r;
+}
+
+static void stream_select(struct jv_parser* p, jv_parse_event kind, jv v) {
+  int depth = p->stacklen;
+  int start = kind == JV_PARSE_EVENT_START_ARRAY || kind == JV_PARSE_EVENT_START_OBJECT;
+  if (p->skipping) {
+    if ((kind == JV_PARSE_EVENT_END_ARRAY || kind == JV_PARSE_EVENT_END_OBJECT) &&
+        depth == p->skipping)
+      p->skipping = 0;
+    jv_free(v);
+    return;
+  }
+  if (p->buildpos == 0) {
+    // Not inside a match; is this the start of one?
+    if (kind != JV_PARSE_EVENT_VALUE && !start) {
+      jv_free(v);
+      return;
+    }
+    int vdepth = start ? depth - 1 : depth;
+    // The containers around this value all matched, or it'd be skipped
+    if (vdepth > 0 && !stream_path_matches(p, vdepth - 1)) {
+      if (start)
+        p->skipping = depth;
+      jv_free(v);
+      return;
+    }
+    if (vdepth < jv_array_length(jv_copy(p->stream_path))) {
+      jv_free(v);
+      return;
+    }
+  }
+
+  switch (kind) {
+  case JV_PARSE_EVENT_START_ARRAY:
+  case JV_PARSE_EVENT_START_OBJECT:
+  case JV_PARSE_EVENT_KEY:
+    if (p->buildpos == p->buildlen) {
+      p->buildlen = p->buildlen * 2 + 10;
+      p->build = jv_mem_realloc(p->build, p->buildlen * sizeof(jv));
+    }
+    if (kind != JV_PARSE_EVENT_KEY) {
+      jv_free(v);
+      v = kind == JV_PARSE_EVENT_START_ARRAY ? jv_array() : jv_object();
+    }
+    p->build[p->buildpos++] = v;
+    return;
+  case JV_PARSE_EVENT_END_ARRAY:
+  case JV_PARSE_EVENT_END_OBJECT:
+    jv_free(v);
+    v = p->build[--p->buildpos];
+    break;
+  default:
+    break;
+  }
+  if (p->buildpos == 0) {
+    stream_queue(p, JV_PARSE_EVENT_VALUE, v);
+  } else if (jv_get_kind(p->build[p->buildpos - 1]) == JV_KIND_ARRAY) {
+    p->build[p->buildpos - 1] = jv_array_append(p->build[p->buildpos - 1], v);
+  } else {
+    jv key = p->build[--p->buildpos];
+    p->build[p->buildpos - 1] = jv_object_set(p->build[p->buildpos - 1], key, v);
+  }
+}
+
+static jv stream_next_event(struct jv_parser* p) {
+  assert(p->nevents > 0);
+  jv v = p->events[p->eventpos].value;
+  p->last_event = p->events[p->eventpos].kind;
+  p->eventpos = (p->eventpos + 1) % MAX_STREAM_EVENTS;
+  p->nevents--;
+  return v;
+}
+
+// A scalar is only known to be complete once the next token is seen
+static void stream_emit_next(struct jv_parser* p) {
+  if (jv_is_valid(p->next)) {
+    stream_emit(p, JV_PARSE_EVENT_VALUE, p->next);
+    p->next = jv_invalid();
+  }
+}
+
 static pfunc stream_token(struct jv_parser* p, char ch) {
   jv_kind k;
   jv last;
@@ -262,6 +432,7 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
     p->path = jv_array_append(p->path, jv_number(0)); // push
     p->last_seen = JV_LAST_OPEN_ARRAY;
     p->stacklen++;
+    stream_emit(p, JV_PARSE_EVENT_START_ARRAY, jv_null());
     break;
 
   case '{':
@@ -282,6 +453,7 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
     p->path = jv_array_append(p->path, jv_null()); // push
     p->last_seen = JV_LAST_OPEN_OBJECT;
     p->stacklen++;
+    stream_emit(p, JV_PARSE_EVENT_START_OBJECT, jv_null());
     break;
 
   case ':':
@@ -298,6 +470,7 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
     if (p->last_seen != JV_LAST_VALUE)
       return "':' should follow a key";
     p->last_seen = JV_LAST_COLON;
+    stream_emit(p, JV_PARSE_EVENT_KEY, jv_copy(p->next));
     p->path = jv_array_set(p->path, p->stacklen - 1, p->next);
     p->next = jv_invalid();
     break;
@@ -312,17 +485,11 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
     if (k == JV_KIND_NUMBER) {
       int idx = jv_number_value(last);
 
-      if (jv_is_valid(p->next)) {
-        p->output = JV_ARRAY(jv_copy(p->path), p->next);
-        p->next = jv_invalid();
-      }
+      stream_emit_next(p);
       p->path = jv_array_set(p->path, p->stacklen - 1, jv_number(idx + 1));
       p->last_seen = JV_LAST_COMMA;
     } else if (k == JV_KIND_STRING) {
-      if (jv_is_valid(p->next)) {
-        p->output = JV_ARRAY(jv_copy(p->path), p->next);
-        p->next = jv_invalid();
-      }
+      stream_emit_next(p);
       p->path = jv_array_set(p->path, p->stacklen - 1, jv_null()); // ready for another key:value pair
       p->last_seen = JV_LAST_COMMA;
     } else {
@@ -349,20 +516,10 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
 
     if (k != JV_KIND_NUMBER)
       return "Unmatched ']' in the middle of an object";
-    if (jv_is_valid(p->next)) {
-      p->output = JV_ARRAY(jv_copy(p->path), p->next, jv_true());
-      p->next = jv_invalid();
-    } else if (p->last_seen != JV_LAST_OPEN_ARRAY) {
-      p->output = JV_ARRAY(jv_copy(p->path));
-    }
+    stream_emit_next(p);
+    stream_emit(p, JV_PARSE_EVENT_END_ARRAY, jv_null());
 
     p->path = jv_array_slice(p->path, 0, --(p->stacklen)); // pop
-    //assert(!jv_is_valid(p->next));
-    jv_free(p->next);
-    p->next = jv_invalid();
-
-    if (p->last_seen == JV_LAST_OPEN_ARRAY)
-      p->output = JV_ARRAY(jv_copy(p->path), jv_array()); // Empty arrays are leaves
 
     if (p->stacklen == 0)
       p->last_seen = JV_LAST_NONE;
@@ -387,8 +544,7 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
     if (jv_is_valid(p->next)) {
       if (k != JV_KIND_STRING)
         return "Objects must consist of key:value pairs";
-      p->output = JV_ARRAY(jv_copy(p->path), p->next, jv_true());
-      p->next = jv_invalid();
+      stream_emit_next(p);
     } else {
       // Perhaps {"a":[]}
       if (p->last_seen == JV_LAST_COLON)
@@ -401,15 +557,9 @@ static pfunc stream_token(struct jv_parser* p, char ch) {
         return "Unmatched '}' in the middle of an array";
       if (p->last_seen != JV_LAST_VALUE && p->last_seen != JV_LAST_OPEN_OBJECT)
         return "Unmatched '}'";
-      if (p->last_seen != JV_LAST_OPEN_OBJECT)
-        p->output = JV_ARRAY(jv_copy(p->path));
     }
+    stream_emit(p, JV_PARSE_EVENT_END_OBJECT, jv_null());
     p->path = jv_array_slice(p->path, 0, --(p->stacklen)); // pop
-    jv_free(p->next);
-    p->next = jv_invalid();
-
-    if (p->last_seen == JV_LAST_OPEN_OBJECT)
-      p->output = JV_ARRAY(jv_copy(p->path), jv_object()); // Empty arrays are leaves
 
     if (p->stacklen == 0)
       p->last_seen = JV_LAST_NONE;
@@ -503,7 +653,17 @@ static pfunc found_string(struct jv_parser* p) {
       *out++ = c;
     }
   }
-  TRY(value(p, jv_string_sized(p->tokenbuf, out - p->tokenbuf)));
+  jv str;
+  if (p->skipping) {
+    str = jv_copy(p->skipped_string);
+  } else if (!(p->flags & JV_PARSE_STREAMING) && p->stackpos > 0 &&
+      jv_get_kind(p->stack[p->stackpos-1]) == JV_KIND_OBJECT) {
+    // an object key: hash it now, while copying it
+    str = jvp_string_key_sized(p->tokenbuf, out - p->tokenbuf);
+  } else {
+    str = jv_string_sized(p->tokenbuf, out - p->tokenbuf);
+  }
+  TRY(value(p, str));
   p->tokenpos = 0;
   return 0;
 }
@@ -531,6 +691,15 @@ static pfunc check_literal(struct jv_parser* p) {
       if (p->tokenbuf[i] != pattern[i])
         return "Invalid literal";
     TRY(value(p, v));
+  } else if (p->skipping) {
+    // Only checked, since it's not going to be output
+    p->tokenbuf[p->tokenpos] = 0;
+    char *end = 0;
+    jvp_strtod(&p->dtoa, p->tokenbuf, &end);
+    if (end == 0 || *end != 0) {
+      return "Invalid numeric literal";
+    }
+    TRY(value(p, jv_number(0)));
   } else {
     // FIXME: better parser
     p->tokenbuf[p->tokenpos] = 0;
@@ -595,26 +764,11 @@ static int parse_check_done(struct jv_parser* p, jv* out) {
   }
 }
 
+// Events stay queued until jv_parser_next() takes them
 static int stream_check_done(struct jv_parser* p, jv* out) {
-  if (p->stacklen == 0 && jv_is_valid(p->next)) {
-    *out = JV_ARRAY(jv_copy(p->path),p->next);
-    p->next = jv_invalid();
-    return 1;
-  } else if (jv_is_valid(p->output)) {
-    if (jv_array_length(jv_copy(p->output)) > 2) {
-      // At end of an array or object, necessitating one more output by
-      // which to indicate this
-      *out = jv_array_slice(jv_copy(p->output), 0, 2);
-      p->output = jv_array_slice(p->output, 0, 1);      // arrange one more output
-    } else {
-      // No further processing needed
-      *out = p->output;
-      p->output = jv_invalid();
-    }
-    return 1;
-  } else {
-    return 0;
-  }
+  if (p->stacklen == 0)
+    stream_emit_next(p);
+  return p->nevents > 0;
 }
 
 static int seq_check_truncation(struct jv_parser* p) {
@@ -713,6 +867,8 @@ static pfunc scan(struct jv_parser* p, char ch, jv* out) {
 }
 
 struct jv_parser* jv_parser_new(int flags) {
+  if ((flags & JV_PARSE_EVENTS))
+    flags = (flags | JV_PARSE_STREAMING) & ~JV_PARSE_STREAM_ERRORS;
   struct jv_parser* p = jv_mem_alloc(sizeof(struct jv_parser));
   parser_init(p, flags);
   p->flags = flags;
@@ -781,8 +937,8 @@ jv jv_parser_next(struct jv_parser* p) {
     parser_reset(p);
   }
   jv value = jv_invalid();
-  if ((p->flags & JV_PARSE_STREAMING) && stream_check_done(p, &value))
-    return value;
+  if ((p->flags & JV_PARSE_STREAMING) && p->nevents > 0)
+    return stream_next_event(p);
   char ch;
   presult msg = 0;
   while (!msg && p->curr_buf_pos < p->curr_buf_length) {
@@ -801,6 +957,8 @@ jv jv_parser_next(struct jv_parser* p) {
     msg = scan(p, ch, &value);
   }
   if (msg == OK) {
+    if ((p->flags & JV_PARSE_STREAMING) && p->nevents > 0)
+      return stream_next_event(p);
     return value;
   } else if (msg) {
     jv_free(value);
@@ -853,7 +1011,8 @@ jv jv_parser_next(struct jv_parser* p) {
     // p->next is either invalid (nothing here, but no syntax error)
     // or valid (this is the value). either way it's the thing to return
     if ((p->flags & JV_PARSE_STREAMING) && jv_is_valid(p->next)) {
-      value = JV_ARRAY(jv_copy(p->path), p->next); // except in streaming mode we've got to make it [path,value]
+      stream_emit_next(p); // except in streaming mode we've got to make it [path,value]
+      value = p->nevents > 0 ? stream_next_event(p) : jv_invalid();
     } else {
       value = p->next;
     }
@@ -866,6 +1025,25 @@ jv jv_parser_next(struct jv_parser* p) {
   }
 }
 
+void jv_parser_set_stream_path(struct jv_parser* p, jv path) {
+  assert((p->flags & JV_PARSE_STREAMING) && !(p->flags & JV_PARSE_EVENTS));
+  assert(jv_get_kind(path) == JV_KIND_ARRAY);
+  jv_free(p->stream_path);
+  p->stream_path = path;
+  if (!jv_is_valid(p->skipped_string))
+    p->skipped_string = jv_string("");
+}
+
+jv_parse_event jv_parser_next_event(struct jv_parser* p, jv* value) {
+  assert((p->flags & JV_PARSE_EVENTS));
+  *value = jv_parser_next(p);
+  if (jv_is_valid(*value))
+    return p->last_event;
+  if (jv_invalid_has_msg(jv_copy(*value)))
+    return JV_PARSE_EVENT_ERROR;
+  return JV_PARSE_EVENT_NONE;
+}
+
 jv jv_parse_sized_custom_flags(const char* string, int length, int flags) {
   struct jv_parser parser;
   parser_init(&parser, flags);
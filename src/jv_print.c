@@ -143,7 +143,7 @@ static void put_indent(int n, int flags, FILE* fout, jv* strout, int T) {
 
 static void jvp_dump_string(jv str, int ascii_only, FILE* F, jv* S, int T) {
   assert(jv_get_kind(str) == JV_KIND_STRING);
-  const char* i = jv_string_value(str);
+  const char* i = jvp_string_bytes(str);
   const char* end = i + jv_string_length_bytes(jv_copy(str));
   const char* cstart;
   int c = 0;
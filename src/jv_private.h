@@ -3,5 +3,11 @@
 
 int jvp_number_cmp(jv, jv);
 int jvp_number_is_nan(jv);
+jv jvp_string_key_sized(const char*, int);
+const char* jvp_string_bytes(jv);
+jv jvp_string_sub(jv, int, int);
+jv jvp_string_ascii_case(jv, unsigned char);
+jv jvp_string_index(jv, jv, int);
+jv jvp_array_index(jv, jv, int);
 
 #endif //JV_PRIVATE
@@ -28,6 +28,7 @@ struct lib_entry {
 struct lib_loading_state {
   struct lib_entry *entries;
   uint64_t ct;
+  jv deps; // files looked at, mapped to whether they existed
 };
 static int load_library(jq_state *jq, jv lib_path,
                         int is_data, int raw, int optional,
@@ -140,8 +141,15 @@ static jv jv_basename(jv name) {
   return res;
 }
 
+static void note_dep(struct lib_loading_state *lib_state, jv path, int exists) {
+  if (lib_state && jv_is_valid(lib_state->deps))
+    lib_state->deps = jv_object_set(lib_state->deps, path, jv_bool(exists));
+  else
+    jv_free(path);
+}
+
 // Asummes validated relative path to module
-static jv find_lib(jq_state *jq, jv rel_path, jv search, const char *suffix, jv jq_origin, jv lib_origin) {
+static jv find_lib(jq_state *jq, jv rel_path, jv search, const char *suffix, jv jq_origin, jv lib_origin, struct lib_loading_state *lib_state) {
   if (!jv_is_valid(rel_path)) {
     jv_free(search);
     jv_free(jq_origin);
@@ -190,7 +198,7 @@ static jv find_lib(jq_state *jq, jv rel_path, jv search, const char *suffix, jv
                                             suffix));
     ret = stat(jv_string_value(testpath),&st);
     if (ret == -1 && errno == ENOENT) {
-      jv_free(testpath);
+      note_dep(lib_state, testpath, 0);
       // Try ${search_dir}/$(dirname ${rel_path})/jq/main.jq
       testpath = jq_realpath(jv_string_fmt("%s/%s/%s%s",
                                            jv_string_value(spath),
@@ -200,7 +208,7 @@ static jv find_lib(jq_state *jq, jv rel_path, jv search, const char *suffix, jv
       ret = stat(jv_string_value(testpath),&st);
     }
     if (ret == -1 && errno == ENOENT) {
-      jv_free(testpath);
+      note_dep(lib_state, testpath, 0);
       // Try ${search_dir}/${rel_path}/$(basename ${rel_path}).jq
       testpath = jq_realpath(jv_string_fmt("%s/%s/%s%s",
                                            jv_string_value(spath),
@@ -208,6 +216,8 @@ static jv find_lib(jq_state *jq, jv rel_path, jv search, const char *suffix, jv
                                            jv_string_value(bname),
                                            suffix));
       ret = stat(jv_string_value(testpath),&st);
+      if (ret == -1 && errno == ENOENT)
+        note_dep(lib_state, jv_copy(testpath), 0);
     }
     if (ret == 0) {
       jv_free(err);
@@ -278,7 +288,7 @@ static int process_dependencies(jq_state *jq, jv jq_origin, jv lib_origin, block
     // dep is now freed; do not reuse
 
     // find_lib does a lot of work that could be cached...
-    jv resolved = find_lib(jq, relpath, search, is_data ? ".json" : ".jq", jv_copy(jq_origin), jv_copy(lib_origin));
+    jv resolved = find_lib(jq, relpath, search, is_data ? ".json" : ".jq", jv_copy(jq_origin), jv_copy(lib_origin), lib_state);
     // XXX ...move the rest of this into a callback.
     if (!jv_is_valid(resolved)) {
       jv_free(as);
@@ -355,6 +365,7 @@ static int load_library(jq_state *jq, jv lib_path, int is_data, int raw, int opt
     data = jv_load_file(jv_string_value(lib_path), 0);
   else
     data = jv_load_file(jv_string_value(lib_path), 1);
+  note_dep(lib_state, jv_copy(lib_path), 1);
   int state_idx;
   if (!jv_is_valid(data)) {
     program = gen_noop();
@@ -408,7 +419,7 @@ static int load_library(jq_state *jq, jv lib_path, int is_data, int raw, int opt
 // as we do in process_dependencies.
 jv load_module_meta(jq_state *jq, jv mod_relpath) {
   // We can't know the caller's origin; we could though, if it was passed in
-  jv lib_path = find_lib(jq, validate_relpath(mod_relpath), jq_get_lib_dirs(jq), ".jq", jq_get_jq_origin(jq), jv_null());
+  jv lib_path = find_lib(jq, validate_relpath(mod_relpath), jq_get_lib_dirs(jq), ".jq", jq_get_jq_origin(jq), jv_null(), NULL);
   if (!jv_is_valid(lib_path))
     return lib_path;
   jv meta = jv_null();
@@ -432,11 +443,16 @@ jv load_module_meta(jq_state *jq, jv mod_relpath) {
   return meta;
 }
 
-int load_program(jq_state *jq, struct locfile* src, block *out_block) {
+// If deps is not NULL, it is set to an object whose keys are the
+// paths of modules and data files looked for, with values telling
+// whether each was there. It is left alone if parsing fails.
+int load_program(jq_state *jq, struct locfile* src, block *out_block, jv *deps,
+                 struct jq_timer *timer) {
   int nerrors = 0;
   block program;
-  struct lib_loading_state lib_state = {0,0};
+  struct lib_loading_state lib_state = {0, 0, jv_invalid()};
   nerrors = jq_parse(src, &program);
+  jq_timer_lap(timer, "parse");
   if (nerrors)
     return nerrors;
 
@@ -458,7 +474,10 @@ int load_program(jq_state *jq, struct locfile* src, block *out_block) {
     jv_free(home);
   }
 
+  if (deps)
+    lib_state.deps = jv_object();
   nerrors = process_dependencies(jq, jq_get_jq_origin(jq), jq_get_prog_origin(jq), &program, &lib_state);
+  jq_timer_lap(timer, "modules");
   block libs = gen_noop();
   for (uint64_t i = 0; i < lib_state.ct; ++i) {
     free(lib_state.entries[i].name);
@@ -468,10 +487,13 @@ int load_program(jq_state *jq, struct locfile* src, block *out_block) {
       block_free(lib_state.entries[i].def);
   }
   free(lib_state.entries);
+  if (deps)
+    *deps = lib_state.deps;
   if (nerrors)
     block_free(program);
   else
     *out_block = block_drop_unreferenced(block_join(libs, program));
+  jq_timer_lap(timer, "link");
 
   return nerrors;
 }
@@ -1,7 +1,10 @@
 #ifndef LINKER_H
 #define LINKER_H
 
-int load_program(jq_state *jq, struct locfile* src, block *out_block);
+struct jq_timer;
+
+int load_program(jq_state *jq, struct locfile* src, block *out_block, jv *deps,
+                 struct jq_timer *timer);
 jv load_module_meta(jq_state *jq, jv modname);
 
 #endif
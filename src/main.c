@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <libgen.h>
+#include <limits.h>
 #ifdef HAVE_SETLOCALE
 #include <locale.h>
 #endif
@@ -90,9 +91,16 @@ static void usage(int code, int keep_it_short) {
       "      --stream              parse the input value in streaming fashion;\n"
       "      --stream-errors       implies --stream and report parse error as\n"
       "                            an array;\n"
+      "      --stream-path path    parse the input in streaming fashion and\n"
+      "                            use only the values at the path (e.g.\n"
+      "                            .items[]) as inputs;\n"
       "      --seq                 parse input/output as application/json-seq;\n"
       "  -f, --from-file           load the filter from a file;\n"
       "  -L, --library-path dir    search modules from the directory;\n"
+      "      --cache-dir dir       reuse compiled programs cached in the\n"
+      "                            directory;\n"
+      "      --limit name n        stop when an input uses more than n bytes\n"
+      "                            (memory), instructions or ms (time);\n"
       "      --arg name value      set $name to the string value;\n"
       "      --argjson name value  set $name to the JSON value;\n"
       "      --slurpfile name file set $name to an array of JSON values read\n"
@@ -103,6 +111,10 @@ static void usage(int code, int keep_it_short) {
       "      --jsonargs            consume remaining arguments as positional\n"
       "                            JSON values;\n"
       "  -e, --exit-status         set exit status code based on the output;\n"
+      "      --profile             print an execution profile to stderr;\n"
+      "      --profile-source      also profile by source line, with an\n"
+      "                            annotated listing of the program;\n"
+      "      --profile-json file   write an execution profile to the file;\n"
 #ifdef WIN32
       "  -b, --binary              open input/output streams in binary mode;\n"
 #endif
@@ -142,6 +154,74 @@ static int isoption(const char** text, char shortopt, const char* longopt, int i
   return 0;
 }
 
+// Parses the paths --stream-path takes, such as .a.b[], .a[0]."b c" and
+// .["a"][], into the array of keys, indexes and nulls (for []) that the
+// parser matches against
+static jv parse_stream_path(const char* text) {
+  const char* p = text;
+  jv path = jv_array();
+  if (!strcmp(p, "."))
+    return path;
+  while (*p) {
+    int dot = *p == '.';
+    if (dot)
+      p++;
+    else if (p == text)
+      break;
+    if (*p == '[') {
+      p++;
+      if (*p == ']') {
+        path = jv_array_append(path, jv_null());
+      } else if (*p == '"') {
+        const char* start = p++;
+        while (*p && *p != '"')
+          p += *p == '\\' && p[1] ? 2 : 1;
+        jv key = jv_parse_sized(start, *p ? p - start + 1 : p - start);
+        if (!jv_is_valid(key) || *p++ != '"') {
+          jv_free(key);
+          break;
+        }
+        path = jv_array_append(path, key);
+      } else if (isdigit((unsigned char)*p)) {
+        char* end;
+        errno = 0;
+        long idx = strtol(p, &end, 10);
+        if (errno || idx > INT_MAX)
+          break;
+        path = jv_array_append(path, jv_number(idx));
+        p = end;
+      } else {
+        break;
+      }
+      if (*p++ != ']')
+        break;
+    } else if (dot && *p == '"') {
+      const char* start = p++;
+      while (*p && *p != '"')
+        p += *p == '\\' && p[1] ? 2 : 1;
+      jv key = jv_parse_sized(start, *p ? p - start + 1 : p - start);
+      if (!jv_is_valid(key) || *p++ != '"') {
+        jv_free(key);
+        break;
+      }
+      path = jv_array_append(path, key);
+    } else if (dot && (isalpha((unsigned char)*p) || *p == '_')) {
+      const char* start = p;
+      while (isalnum((unsigned char)*p) || *p == '_')
+        p++;
+      path = jv_array_append(path, jv_string_sized(start, p - start));
+    } else {
+      p -= dot;
+      break;
+    }
+  }
+  if (*p || p == text) {
+    jv_free(path);
+    return jv_invalid();
+  }
+  return path;
+}
+
 enum {
   SLURP                 = 1,
   RAW_INPUT             = 2,
@@ -159,6 +239,10 @@ enum {
   SEQ                   = 16384,
   /* debugging only */
   DUMP_DISASM           = 32768,
+  DEBUG_TIMINGS         = 65536,
+  PROFILE               = 131072,
+  PROFILE_SOURCE        = 262144,
+  DEBUG_MEMSTATS        = 524288,
 };
 
 enum {
@@ -297,6 +381,9 @@ int main(int argc, char* argv[]) {
   int last_result = -1; /* -1 = no result, 0=null or false, 1=true */
   int badwrite;
   int options = 0;
+  struct jq_timer timer_state, *timer = NULL;
+
+  jq_timer_start(&timer_state);
 
 #ifdef HAVE_SETLOCALE
   (void) setlocale(LC_ALL, "");
@@ -324,6 +411,14 @@ int main(int argc, char* argv[]) {
   _setmode(fileno(stderr), _O_TEXT | _O_U8TEXT);
 #endif
 
+  // Freeing values allocated before counting starts would throw the
+  // live counts off, so look for options that count memory first
+  for (int i = 1; i < argc && strcmp(argv[i], "--"); i++) {
+    if (!strcmp(argv[i], "--debug-memstats") ||
+        (!strcmp(argv[i], "--limit") && i + 1 < argc && !strcmp(argv[i+1], "memory")))
+      jv_mem_stats_enable(1);
+  }
+
   jv ARGS = jv_array(); /* positional arguments */
   jv program_arguments = jv_object(); /* named arguments */
 
@@ -344,6 +439,9 @@ int main(int argc, char* argv[]) {
   int args_done = 0;
   int jq_flags = 0;
   jv lib_search_paths = jv_null();
+  jv cache_dir = jv_null();
+  jv stream_path = jv_invalid();
+  const char *profile_file = NULL;
   for (int i=1; i<argc; i++) {
     if (args_done || !isoptish(argv[i])) {
       if (!program) {
@@ -444,12 +542,58 @@ int main(int argc, char* argv[]) {
           dumpopts &= ~(JV_PRINT_TAB | JV_PRINT_INDENT_FLAGS(7));
           dumpopts |= JV_PRINT_INDENT_FLAGS(indent);
           i++;
+        } else if (isoption(&text, 0, "limit", is_short)) {
+          if (i >= argc - 2) {
+            fprintf(stderr, "jq: --limit takes two parameters (e.g. --limit memory 1e9)\n");
+            die();
+          }
+          jq_limit limit;
+          if (!strcmp(argv[i+1], "memory")) {
+            limit = JQ_LIMIT_MEMORY;
+          } else if (!strcmp(argv[i+1], "instructions")) {
+            limit = JQ_LIMIT_INSTRUCTIONS;
+          } else if (!strcmp(argv[i+1], "time")) {
+            limit = JQ_LIMIT_TIME;
+          } else {
+            fprintf(stderr, "jq: --limit takes memory, instructions or time, not %s\n", argv[i+1]);
+            die();
+          }
+          char* end = NULL;
+          errno = 0;
+          double value = strtod(argv[i+2], &end);
+          if (errno || !(value >= 0) || isspace((unsigned char)*argv[i+2]) ||
+              end == argv[i+2] || *end) {
+            fprintf(stderr, "jq: --limit %s takes a non-negative number\n", argv[i+1]);
+            die();
+          }
+          jq_set_limit(jq, limit, value);
+          i += 2;
+        } else if (isoption(&text, 0, "cache-dir", is_short)) {
+          if (i >= argc - 1) {
+            fprintf(stderr, "jq: --cache-dir takes one parameter\n");
+            die();
+          }
+          jv_free(cache_dir);
+          cache_dir = jv_string(argv[i+1]);
+          i++;
         } else if (isoption(&text, 0, "seq", is_short)) {
           options |= SEQ;
         } else if (isoption(&text, 0, "stream", is_short)) {
           parser_flags |= JV_PARSE_STREAMING;
         } else if (isoption(&text, 0, "stream-errors", is_short)) {
           parser_flags |= JV_PARSE_STREAMING | JV_PARSE_STREAM_ERRORS;
+        } else if (isoption(&text, 0, "stream-path", is_short)) {
+          if (i >= argc - 1) {
+            fprintf(stderr, "jq: --stream-path takes one parameter (e.g. --stream-path '.items[]')\n");
+            die();
+          }
+          jv_free(stream_path);
+          stream_path = parse_stream_path(argv[i+1]);
+          if (!jv_is_valid(stream_path)) {
+            fprintf(stderr, "jq: --stream-path takes a path like .a.b[] or .a[0].\"b\", not %s\n", argv[i+1]);
+            die();
+          }
+          i++;
         } else if (isoption(&text, 'e', "exit-status", is_short)) {
           options |= EXIT_STATUS;
         } else if (isoption(&text, 0, "args", is_short)) {
@@ -502,6 +646,23 @@ int main(int argc, char* argv[]) {
           i += 2; // skip the next two arguments
         } else if (isoption(&text,  0,  "debug-dump-disasm", is_short)) {
           options |= DUMP_DISASM;
+        } else if (isoption(&text,  0,  "debug-timings", is_short)) {
+          options |= DEBUG_TIMINGS;
+          // For its allocation counts; only live counts need it sooner
+          jv_mem_stats_enable(1);
+        } else if (isoption(&text,  0,  "debug-memstats", is_short)) {
+          options |= DEBUG_MEMSTATS;
+        } else if (isoption(&text,  0,  "profile", is_short)) {
+          options |= PROFILE;
+        } else if (isoption(&text,  0,  "profile-source", is_short)) {
+          options |= PROFILE | PROFILE_SOURCE;
+        } else if (isoption(&text,  0,  "profile-json", is_short)) {
+          if (i >= argc - 1) {
+            fprintf(stderr, "jq: --profile-json takes one parameter\n");
+            die();
+          }
+          profile_file = argv[i+1];
+          i++;
         } else if (isoption(&text,  0,  "debug-trace=all", is_short)) {
           jq_flags |= JQ_DEBUG_TRACE_ALL;
         } else if (isoption(&text,  0,  "debug-trace", is_short)) {
@@ -536,6 +697,18 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  if (jv_is_valid(stream_path)) {
+    // Each of these reads the input some other way
+    const char *other = (parser_flags & JV_PARSE_STREAM_ERRORS) ? "--stream-errors" :
+      (parser_flags & JV_PARSE_STREAMING) ? "--stream" :
+      (options & SLURP) ? "--slurp" : (options & RAW_INPUT) ? "--raw-input" : NULL;
+    if (other) {
+      fprintf(stderr, "jq: --stream-path cannot be used with %s\n", other);
+      die();
+    }
+    parser_flags |= JV_PARSE_STREAMING;
+  }
+
 #ifdef USE_ISATTY
   if (isatty(STDOUT_FILENO)) {
 #ifndef WIN32
@@ -575,6 +748,16 @@ int main(int argc, char* argv[]) {
                                 jv_string("$ORIGIN/../lib"));
   }
   jq_set_attr(jq, jv_string("JQ_LIBRARY_PATH"), lib_search_paths);
+  if (jv_get_kind(cache_dir) == JV_KIND_STRING)
+    jq_set_attr(jq, jv_string("JQ_CACHE_DIR"), cache_dir);
+  else
+    jv_free(cache_dir);
+  if (options & DEBUG_TIMINGS) {
+    timer = &timer_state;
+    jq_set_attr(jq, jv_string("JQ_DEBUG_TIMINGS"), jv_true());
+  }
+  if ((options & PROFILE) || profile_file)
+    jq_set_profiling(jq, JQ_PROFILE | ((options & PROFILE_SOURCE) ? JQ_PROFILE_SOURCE : 0));
 
   char *origin = strdup(argv[0]);
   if (origin == NULL) {
@@ -596,6 +779,8 @@ int main(int argc, char* argv[]) {
 
   if (!program) usage(2, 1);
 
+  jq_timer_lap(timer, "startup");
+
   if (options & FROM_FILE) {
     char *program_origin = strdup(program);
     if (program_origin == NULL) {
@@ -646,6 +831,8 @@ int main(int argc, char* argv[]) {
     ret = JQ_ERROR_COMPILE;
     goto out;
   }
+  if (timer)
+    jq_timer_start(timer);
 
   if (options & DUMP_DISASM) {
     jq_dump_disassembly(jq, 0);
@@ -655,10 +842,15 @@ int main(int argc, char* argv[]) {
   if ((options & SEQ))
     parser_flags |= JV_PARSE_SEQ;
 
-  if ((options & RAW_INPUT))
+  if ((options & RAW_INPUT)) {
     jq_util_input_set_parser(input_state, NULL, (options & SLURP) ? 1 : 0);
-  else
-    jq_util_input_set_parser(input_state, jv_parser_new(parser_flags), (options & SLURP) ? 1 : 0);
+    jv_free(stream_path);
+  } else {
+    jv_parser *parser = jv_parser_new(parser_flags);
+    if (jv_is_valid(stream_path))
+      jv_parser_set_stream_path(parser, stream_path);
+    jq_util_input_set_parser(input_state, parser, (options & SLURP) ? 1 : 0);
+  }
 
   // Let jq program read from inputs
   jq_set_input_cb(jq, jq_util_input_next_input_cb, input_state);
@@ -703,6 +895,26 @@ int main(int argc, char* argv[]) {
 
   if (jq_util_input_errors(input_state) != 0)
     ret = JQ_ERROR_SYSTEM;
+  jq_timer_lap(timer, "run");
+
+  if (options & PROFILE)
+    jq_dump_profile(jq, stderr);
+  if (options & DEBUG_MEMSTATS)
+    jq_dump_memstats(jq, stderr);
+  if (profile_file) {
+    FILE *f = fopen(profile_file, "w");
+    if (f == NULL) {
+      fprintf(stderr, "jq: error: could not open %s: %s\n", profile_file, strerror(errno));
+      ret = JQ_ERROR_SYSTEM;
+    } else {
+      jv_dumpf(jq_get_profile(jq), f, 0);
+      fprintf(f, "\n");
+      if (fclose(f) != 0) {
+        fprintf(stderr, "jq: error: writing %s failed: %s\n", profile_file, strerror(errno));
+        ret = JQ_ERROR_SYSTEM;
+      }
+    }
+  }
 
 out:
   badwrite = ferror(stdout);
@@ -715,6 +927,7 @@ out:
   jv_free(program_arguments);
   jq_util_input_free(&input_state);
   jq_teardown(&jq);
+  jq_timer_lap(timer, "teardown");
 
   if (options & EXIT_STATUS) {
     if (ret != JQ_OK_NO_OUTPUT)
@@ -0,0 +1,174 @@
+/*
+ * Attribution of jv allocations to what caused them, behind
+ * --debug-memstats.
+ *
+ * jv_mem_stats_get() counts the values allocated by each thread.  The
+ * interpreter tells us before every instruction which opcode it's about
+ * to run, and after every C builtin which builtin ran, and whatever was
+ * allocated since the previous call is charged to the opcode or builtin
+ * that was running.  Builtins are identified by their struct cfunction
+ * pointers, so the counts have to be reset whenever the program is
+ * replaced.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "jv_alloc.h"
+
+struct memstats_site {
+  const struct cfunction *cf;
+  uint64_t allocs;
+  uint64_t bytes;
+};
+
+struct memstats {
+  struct memstats_site ops[NUM_OPCODES];
+  struct memstats_site *builtins;
+  int nbuiltins;
+  int op;            // charged for what's allocated next, or -1
+  uint64_t allocs;   // totals when op started
+  uint64_t bytes;
+};
+
+struct memstats *memstats_new(void) {
+  struct memstats *m = jv_mem_calloc(1, sizeof(struct memstats));
+  m->op = -1;
+  return m;
+}
+
+void memstats_free(struct memstats *m) {
+  if (m == NULL)
+    return;
+  jv_mem_free(m->builtins);
+  jv_mem_free(m);
+}
+
+void memstats_reset(struct memstats *m) {
+  memset(m->ops, 0, sizeof(m->ops));
+  jv_mem_free(m->builtins);
+  m->builtins = NULL;
+  m->nbuiltins = 0;
+  m->op = -1;
+}
+
+// Charges what was allocated since the last call to site
+static void charge(struct memstats *m, struct memstats_site *site) {
+  const struct jv_mem_stats *total = &jv_mem_stats_get()[JV_MEM_TOTAL];
+  if (site) {
+    site->allocs += total->allocs - m->allocs;
+    site->bytes += total->alloc_bytes - m->bytes;
+  }
+  m->allocs = total->allocs;
+  m->bytes = total->alloc_bytes;
+}
+
+void memstats_resume(struct memstats *m) {
+  charge(m, NULL);
+  m->op = -1;
+}
+
+void memstats_pause(struct memstats *m) {
+  charge(m, m->op >= 0 ? &m->ops[m->op] : NULL);
+  m->op = -1;
+}
+
+void memstats_step(struct memstats *m, uint16_t op) {
+  charge(m, m->op >= 0 ? &m->ops[m->op] : NULL);
+  m->op = op;
+}
+
+void memstats_builtin(struct memstats *m, const struct cfunction *cf) {
+  int i = 0;
+  while (i < m->nbuiltins && m->builtins[i].cf != cf)
+    i++;
+  if (i == m->nbuiltins) {
+    // Grow by powers of two
+    if ((i & (i - 1)) == 0)
+      m->builtins = jv_mem_realloc(m->builtins, (i ? i * 2 : 1) * sizeof(struct memstats_site));
+    memset(&m->builtins[i], 0, sizeof(struct memstats_site));
+    m->builtins[i].cf = cf;
+    m->nbuiltins++;
+  }
+  charge(m, &m->builtins[i]);
+}
+
+static jv site_report(struct memstats_site *site) {
+  return JV_OBJECT(jv_string("allocs"), jv_number(site->allocs),
+                   jv_string("bytes"), jv_number(site->bytes));
+}
+
+// jv_mem_stats(), with the allocations made by each opcode and builtin
+jv memstats_report(struct memstats *m) {
+  jv report = jv_mem_stats();
+  jv ops = jv_object();
+  for (int i = 0; i < NUM_OPCODES; i++) {
+    if (m->ops[i].allocs)
+      ops = jv_object_set(ops, jv_string(opcode_describe(i)->name), site_report(&m->ops[i]));
+  }
+  jv builtins = jv_object();
+  for (int i = 0; i < m->nbuiltins; i++) {
+    if (m->builtins[i].allocs)
+      builtins = jv_object_set(builtins,
+                               jv_string_fmt("%s/%d", m->builtins[i].cf->name,
+                                             m->builtins[i].cf->nargs - 1),
+                               site_report(&m->builtins[i]));
+  }
+  report = jv_object_set(report, jv_string("opcodes"), ops);
+  return jv_object_set(report, jv_string("builtins"), builtins);
+}
+
+static double field(jv o, const char *name) {
+  jv v = jv_object_get(jv_copy(o), jv_string(name));
+  double d = jv_get_kind(v) == JV_KIND_NUMBER ? jv_number_value(v) : 0;
+  jv_free(v);
+  return d;
+}
+
+// Appends the sites in an object of them to an array, with their names
+// prefixed by kind
+static jv add_sites(jv sites, jv o, const char *kind) {
+  jv_object_foreach(o, name, site) {
+    site = jv_object_set(site, jv_string("name"),
+                         jv_string_fmt("%s %s", kind, jv_string_value(name)));
+    sites = jv_array_append(sites, site);
+    jv_free(name);
+  }
+  jv_free(o);
+  return sites;
+}
+
+// Prints a report made by memstats_report()
+void memstats_dump(jv report, FILE *f) {
+  static const char *kinds[] = {"string", "array", "object", "number", "total"};
+  fprintf(f, "jq: memstats:\n%-8s %10s %12s %10s %12s %10s %12s\n",
+          "kind", "live", "live bytes", "peak", "peak bytes", "allocs", "alloc bytes");
+  for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+    jv k = jv_object_get(jv_copy(report), jv_string(kinds[i]));
+    fprintf(f, "%-8s %10.0f %12.0f %10.0f %12.0f %10.0f %12.0f\n", kinds[i],
+            field(k, "live"), field(k, "live_bytes"), field(k, "peak"),
+            field(k, "peak_bytes"), field(k, "allocs"), field(k, "alloc_bytes"));
+    jv_free(k);
+  }
+
+  jv sites = add_sites(jv_array(), jv_object_get(jv_copy(report), jv_string("opcodes")), "opcode");
+  sites = add_sites(sites, jv_object_get(jv_copy(report), jv_string("builtins")), "builtin");
+  // Most bytes first
+  jv keys = jv_array();
+  jv_array_foreach(sites, i, site) {
+    keys = jv_array_append(keys, jv_number(-field(site, "bytes")));
+    jv_free(site);
+  }
+  sites = jv_sort(sites, keys);
+  fprintf(f, "\n%12s %10s  %s\n", "alloc bytes", "allocs", "allocated by");
+  jv_array_foreach(sites, i, site) {
+    jv name = jv_object_get(jv_copy(site), jv_string("name"));
+    fprintf(f, "%12.0f %10.0f  %s\n", field(site, "bytes"), field(site, "allocs"),
+            jv_string_value(name));
+    jv_free(name);
+    jv_free(site);
+  }
+  jv_free(sites);
+  jv_free(report);
+}
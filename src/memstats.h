@@ -0,0 +1,20 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include "bytecode.h"
+
+struct memstats;
+
+struct memstats *memstats_new(void);
+void memstats_free(struct memstats *);
+void memstats_reset(struct memstats *);
+
+void memstats_resume(struct memstats *);
+void memstats_pause(struct memstats *);
+void memstats_step(struct memstats *, uint16_t);
+void memstats_builtin(struct memstats *, const struct cfunction *);
+
+jv memstats_report(struct memstats *);
+void memstats_dump(jv, FILE *);
+
+#endif
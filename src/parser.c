@@ -462,6 +462,11 @@ static block constant_fold(block a, block b, int op) {
   if (!block_is_single(a) || !block_is_const(a) ||
       !block_is_single(b) || !block_is_const(b))
     return gen_noop();
+  // Repeating a string can make a value of any size, which is better
+  // left to run time, where --limit applies
+  if (op == '*' &&
+      (block_const_kind(a) == JV_KIND_STRING || block_const_kind(b) == JV_KIND_STRING))
+    return gen_noop();
 
   jv jv_a = block_const(a);
   block_free(a);
@@ -543,7 +548,7 @@ static block gen_loc_object(location *loc, struct locfile *locations) {
 }
 
 
-#line 547 "src/parser.c"
+#line 552 "src/parser.c"
 
 
 #ifdef short
@@ -933,23 +938,23 @@ static const yytype_int8 yytranslate[] =
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int16 yyrline[] =
 {
-       0,   282,   282,   285,   290,   293,   308,   311,   316,   319,
-     325,   328,   331,   337,   340,   343,   349,   352,   355,   358,
-     361,   364,   367,   370,   373,   376,   379,   382,   385,   388,
-     391,   394,   397,   400,   403,   406,   409,   412,   415,   421,
-     424,   441,   445,   449,   455,   466,   471,   477,   480,   485,
-     489,   496,   499,   505,   512,   515,   518,   524,   527,   530,
-     536,   539,   542,   550,   554,   557,   560,   563,   566,   569,
-     572,   575,   578,   582,   588,   591,   594,   597,   600,   603,
-     606,   609,   612,   615,   618,   621,   624,   627,   630,   633,
-     636,   639,   642,   645,   648,   651,   654,   661,   664,   667,
-     670,   673,   677,   680,   684,   702,   706,   710,   713,   725,
-     730,   731,   732,   733,   736,   739,   744,   749,   752,   757,
-     760,   765,   769,   772,   777,   780,   785,   788,   793,   796,
-     799,   802,   805,   808,   816,   822,   825,   828,   831,   834,
-     837,   840,   843,   846,   849,   852,   855,   858,   861,   864,
-     867,   870,   873,   879,   882,   885,   890,   893,   896,   899,
-     903,   908,   912,   916,   920,   924,   932,   938,   941
+       0,   287,   287,   290,   295,   298,   313,   316,   321,   324,
+     330,   333,   336,   342,   345,   348,   354,   357,   360,   363,
+     366,   369,   372,   375,   378,   381,   384,   387,   390,   393,
+     396,   399,   402,   405,   408,   411,   414,   417,   420,   426,
+     429,   446,   450,   454,   460,   471,   476,   482,   485,   490,
+     494,   501,   504,   510,   517,   520,   523,   529,   532,   535,
+     541,   544,   547,   555,   559,   562,   565,   568,   571,   574,
+     577,   580,   583,   587,   593,   596,   599,   602,   605,   608,
+     611,   614,   617,   620,   623,   626,   629,   632,   635,   638,
+     641,   644,   647,   650,   653,   656,   659,   666,   669,   672,
+     675,   678,   682,   685,   689,   707,   711,   715,   718,   730,
+     735,   736,   737,   738,   741,   744,   749,   754,   757,   762,
+     765,   770,   774,   777,   782,   785,   790,   793,   798,   801,
+     804,   807,   810,   813,   821,   827,   830,   833,   836,   839,
+     842,   845,   848,   851,   854,   857,   860,   863,   866,   869,
+     872,   875,   878,   884,   887,   890,   895,   898,   901,   904,
+     908,   913,   917,   921,   925,   929,   937,   943,   946
 };
 #endif
 
@@ -2000,205 +2005,205 @@ yydestruct (const char *yymsg,
     case YYSYMBOL_IDENT: /* IDENT  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2004 "src/parser.c"
+#line 2009 "src/parser.c"
         break;
 
     case YYSYMBOL_FIELD: /* FIELD  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2010 "src/parser.c"
+#line 2015 "src/parser.c"
         break;
 
     case YYSYMBOL_BINDING: /* BINDING  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2016 "src/parser.c"
+#line 2021 "src/parser.c"
         break;
 
     case YYSYMBOL_LITERAL: /* LITERAL  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2022 "src/parser.c"
+#line 2027 "src/parser.c"
         break;
 
     case YYSYMBOL_FORMAT: /* FORMAT  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2028 "src/parser.c"
+#line 2033 "src/parser.c"
         break;
 
     case YYSYMBOL_QQSTRING_TEXT: /* QQSTRING_TEXT  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2034 "src/parser.c"
+#line 2039 "src/parser.c"
         break;
 
     case YYSYMBOL_Module: /* Module  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2040 "src/parser.c"
+#line 2045 "src/parser.c"
         break;
 
     case YYSYMBOL_Imports: /* Imports  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2046 "src/parser.c"
+#line 2051 "src/parser.c"
         break;
 
     case YYSYMBOL_FuncDefs: /* FuncDefs  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2052 "src/parser.c"
+#line 2057 "src/parser.c"
         break;
 
     case YYSYMBOL_Query: /* Query  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2058 "src/parser.c"
+#line 2063 "src/parser.c"
         break;
 
     case YYSYMBOL_Expr: /* Expr  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2064 "src/parser.c"
+#line 2069 "src/parser.c"
         break;
 
     case YYSYMBOL_Import: /* Import  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2070 "src/parser.c"
+#line 2075 "src/parser.c"
         break;
 
     case YYSYMBOL_ImportWhat: /* ImportWhat  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2076 "src/parser.c"
+#line 2081 "src/parser.c"
         break;
 
     case YYSYMBOL_ImportFrom: /* ImportFrom  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2082 "src/parser.c"
+#line 2087 "src/parser.c"
         break;
 
     case YYSYMBOL_FuncDef: /* FuncDef  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2088 "src/parser.c"
+#line 2093 "src/parser.c"
         break;
 
     case YYSYMBOL_Params: /* Params  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2094 "src/parser.c"
+#line 2099 "src/parser.c"
         break;
 
     case YYSYMBOL_Param: /* Param  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2100 "src/parser.c"
+#line 2105 "src/parser.c"
         break;
 
     case YYSYMBOL_StringStart: /* StringStart  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2106 "src/parser.c"
+#line 2111 "src/parser.c"
         break;
 
     case YYSYMBOL_String: /* String  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2112 "src/parser.c"
+#line 2117 "src/parser.c"
         break;
 
     case YYSYMBOL_QQString: /* QQString  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2118 "src/parser.c"
+#line 2123 "src/parser.c"
         break;
 
     case YYSYMBOL_ElseBody: /* ElseBody  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2124 "src/parser.c"
+#line 2129 "src/parser.c"
         break;
 
     case YYSYMBOL_Term: /* Term  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2130 "src/parser.c"
+#line 2135 "src/parser.c"
         break;
 
     case YYSYMBOL_Args: /* Args  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2136 "src/parser.c"
+#line 2141 "src/parser.c"
         break;
 
     case YYSYMBOL_Arg: /* Arg  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2142 "src/parser.c"
+#line 2147 "src/parser.c"
         break;
 
     case YYSYMBOL_RepPatterns: /* RepPatterns  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2148 "src/parser.c"
+#line 2153 "src/parser.c"
         break;
 
     case YYSYMBOL_Patterns: /* Patterns  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2154 "src/parser.c"
+#line 2159 "src/parser.c"
         break;
 
     case YYSYMBOL_Pattern: /* Pattern  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2160 "src/parser.c"
+#line 2165 "src/parser.c"
         break;
 
     case YYSYMBOL_ArrayPats: /* ArrayPats  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2166 "src/parser.c"
+#line 2171 "src/parser.c"
         break;
 
     case YYSYMBOL_ObjPats: /* ObjPats  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2172 "src/parser.c"
+#line 2177 "src/parser.c"
         break;
 
     case YYSYMBOL_ObjPat: /* ObjPat  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2178 "src/parser.c"
+#line 2183 "src/parser.c"
         break;
 
     case YYSYMBOL_Keyword: /* Keyword  */
 #line 37 "src/parser.y"
             { jv_free(((*yyvaluep).literal)); }
-#line 2184 "src/parser.c"
+#line 2189 "src/parser.c"
         break;
 
     case YYSYMBOL_DictPairs: /* DictPairs  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2190 "src/parser.c"
+#line 2195 "src/parser.c"
         break;
 
     case YYSYMBOL_DictPair: /* DictPair  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2196 "src/parser.c"
+#line 2201 "src/parser.c"
         break;
 
     case YYSYMBOL_DictExpr: /* DictExpr  */
 #line 38 "src/parser.y"
             { block_free(((*yyvaluep).blk)); }
-#line 2202 "src/parser.c"
+#line 2207 "src/parser.c"
         break;
 
       default:
@@ -2502,31 +2507,31 @@ yyreduce:
   switch (yyn)
     {
   case 2: /* TopLevel: Module Imports Query  */
-#line 282 "src/parser.y"
+#line 287 "src/parser.y"
                      {
   *answer = BLOCK((yyvsp[-2].blk), (yyvsp[-1].blk), gen_op_simple(TOP), (yyvsp[0].blk));
 }
-#line 2510 "src/parser.c"
+#line 2515 "src/parser.c"
     break;
 
   case 3: /* TopLevel: Module Imports FuncDefs  */
-#line 285 "src/parser.y"
+#line 290 "src/parser.y"
                         {
   *answer = BLOCK((yyvsp[-2].blk), (yyvsp[-1].blk), (yyvsp[0].blk));
 }
-#line 2518 "src/parser.c"
+#line 2523 "src/parser.c"
     break;
 
   case 4: /* Module: %empty  */
-#line 290 "src/parser.y"
+#line 295 "src/parser.y"
        {
   (yyval.blk) = gen_noop();
 }
-#line 2526 "src/parser.c"
+#line 2531 "src/parser.c"
     break;
 
   case 5: /* Module: "module" Query ';'  */
-#line 293 "src/parser.y"
+#line 298 "src/parser.y"
                    {
   if (!block_is_const((yyvsp[-1].blk))) {
     FAIL((yylsp[-1]), "Module metadata must be constant");
@@ -2540,286 +2545,286 @@ yyreduce:
     (yyval.blk) = gen_module((yyvsp[-1].blk));
   }
 }
-#line 2544 "src/parser.c"
+#line 2549 "src/parser.c"
     break;
 
   case 6: /* Imports: %empty  */
-#line 308 "src/parser.y"
+#line 313 "src/parser.y"
        {
   (yyval.blk) = gen_noop();
 }
-#line 2552 "src/parser.c"
+#line 2557 "src/parser.c"
     break;
 
   case 7: /* Imports: Import Imports  */
-#line 311 "src/parser.y"
+#line 316 "src/parser.y"
                {
   (yyval.blk) = BLOCK((yyvsp[-1].blk), (yyvsp[0].blk));
 }
-#line 2560 "src/parser.c"
+#line 2565 "src/parser.c"
     break;
 
   case 8: /* FuncDefs: %empty  */
-#line 316 "src/parser.y"
+#line 321 "src/parser.y"
        {
   (yyval.blk) = gen_noop();
 }
-#line 2568 "src/parser.c"
+#line 2573 "src/parser.c"
     break;
 
   case 9: /* FuncDefs: FuncDef FuncDefs  */
-#line 319 "src/parser.y"
+#line 324 "src/parser.y"
                  {
   (yyval.blk) = block_join((yyvsp[-1].blk), (yyvsp[0].blk));
 }
-#line 2576 "src/parser.c"
+#line 2581 "src/parser.c"
     break;
 
   case 10: /* Query: FuncDef Query  */
-#line 325 "src/parser.y"
+#line 330 "src/parser.y"
                             {
   (yyval.blk) = block_bind_referenced((yyvsp[-1].blk), (yyvsp[0].blk), OP_IS_CALL_PSEUDO);
 }
-#line 2584 "src/parser.c"
+#line 2589 "src/parser.c"
     break;
 
   case 11: /* Query: Expr "as" Patterns '|' Query  */
-#line 328 "src/parser.y"
+#line 333 "src/parser.y"
                              {
   (yyval.blk) = gen_destructure((yyvsp[-4].blk), (yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2592 "src/parser.c"
+#line 2597 "src/parser.c"
     break;
 
   case 12: /* Query: "label" BINDING '|' Query  */
-#line 331 "src/parser.y"
+#line 336 "src/parser.y"
                           {
   jv v = jv_string_fmt("*label-%s", jv_string_value((yyvsp[-2].literal)));
   (yyval.blk) = gen_location((yyloc), locations, gen_label(jv_string_value(v), (yyvsp[0].blk)));
   jv_free((yyvsp[-2].literal));
   jv_free(v);
 }
-#line 2603 "src/parser.c"
+#line 2608 "src/parser.c"
     break;
 
   case 13: /* Query: Query '|' Query  */
-#line 337 "src/parser.y"
+#line 342 "src/parser.y"
                 {
   (yyval.blk) = block_join((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2611 "src/parser.c"
+#line 2616 "src/parser.c"
     break;
 
   case 14: /* Query: Query ',' Query  */
-#line 340 "src/parser.y"
+#line 345 "src/parser.y"
                 {
   (yyval.blk) = gen_both((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2619 "src/parser.c"
+#line 2624 "src/parser.c"
     break;
 
   case 15: /* Query: Expr  */
-#line 343 "src/parser.y"
+#line 348 "src/parser.y"
      {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 2627 "src/parser.c"
+#line 2632 "src/parser.c"
     break;
 
   case 16: /* Expr: Expr "//" Expr  */
-#line 349 "src/parser.y"
+#line 354 "src/parser.y"
                {
   (yyval.blk) = gen_definedor((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2635 "src/parser.c"
+#line 2640 "src/parser.c"
     break;
 
   case 17: /* Expr: Expr '=' Expr  */
-#line 352 "src/parser.y"
+#line 357 "src/parser.y"
               {
   (yyval.blk) = gen_call("_assign", BLOCK(gen_lambda((yyvsp[-2].blk)), gen_lambda((yyvsp[0].blk))));
 }
-#line 2643 "src/parser.c"
+#line 2648 "src/parser.c"
     break;
 
   case 18: /* Expr: Expr "or" Expr  */
-#line 355 "src/parser.y"
+#line 360 "src/parser.y"
                {
   (yyval.blk) = gen_or((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2651 "src/parser.c"
+#line 2656 "src/parser.c"
     break;
 
   case 19: /* Expr: Expr "and" Expr  */
-#line 358 "src/parser.y"
+#line 363 "src/parser.y"
                 {
   (yyval.blk) = gen_and((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2659 "src/parser.c"
+#line 2664 "src/parser.c"
     break;
 
   case 20: /* Expr: Expr "//=" Expr  */
-#line 361 "src/parser.y"
+#line 366 "src/parser.y"
                 {
   (yyval.blk) = gen_definedor_assign((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2667 "src/parser.c"
+#line 2672 "src/parser.c"
     break;
 
   case 21: /* Expr: Expr "|=" Expr  */
-#line 364 "src/parser.y"
+#line 369 "src/parser.y"
                {
   (yyval.blk) = gen_call("_modify", BLOCK(gen_lambda((yyvsp[-2].blk)), gen_lambda((yyvsp[0].blk))));
 }
-#line 2675 "src/parser.c"
+#line 2680 "src/parser.c"
     break;
 
   case 22: /* Expr: Expr '+' Expr  */
-#line 367 "src/parser.y"
+#line 372 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '+');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '+'));
 }
-#line 2683 "src/parser.c"
+#line 2688 "src/parser.c"
     break;
 
   case 23: /* Expr: Expr "+=" Expr  */
-#line 370 "src/parser.y"
+#line 375 "src/parser.y"
                {
   (yyval.blk) = gen_update((yyvsp[-2].blk), (yyvsp[0].blk), '+');
 }
-#line 2691 "src/parser.c"
+#line 2696 "src/parser.c"
     break;
 
   case 24: /* Expr: Expr '-' Expr  */
-#line 373 "src/parser.y"
+#line 378 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '-');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '-'));
 }
-#line 2699 "src/parser.c"
+#line 2704 "src/parser.c"
     break;
 
   case 25: /* Expr: Expr "-=" Expr  */
-#line 376 "src/parser.y"
+#line 381 "src/parser.y"
                {
   (yyval.blk) = gen_update((yyvsp[-2].blk), (yyvsp[0].blk), '-');
 }
-#line 2707 "src/parser.c"
+#line 2712 "src/parser.c"
     break;
 
   case 26: /* Expr: Expr '*' Expr  */
-#line 379 "src/parser.y"
+#line 384 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '*');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '*'));
 }
-#line 2715 "src/parser.c"
+#line 2720 "src/parser.c"
     break;
 
   case 27: /* Expr: Expr "*=" Expr  */
-#line 382 "src/parser.y"
+#line 387 "src/parser.y"
                {
   (yyval.blk) = gen_update((yyvsp[-2].blk), (yyvsp[0].blk), '*');
 }
-#line 2723 "src/parser.c"
+#line 2728 "src/parser.c"
     break;
 
   case 28: /* Expr: Expr '/' Expr  */
-#line 385 "src/parser.y"
+#line 390 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '/');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '/'));
 }
-#line 2731 "src/parser.c"
+#line 2736 "src/parser.c"
     break;
 
   case 29: /* Expr: Expr '%' Expr  */
-#line 388 "src/parser.y"
+#line 393 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '%');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '%'));
 }
-#line 2739 "src/parser.c"
+#line 2744 "src/parser.c"
     break;
 
   case 30: /* Expr: Expr "/=" Expr  */
-#line 391 "src/parser.y"
+#line 396 "src/parser.y"
                {
   (yyval.blk) = gen_update((yyvsp[-2].blk), (yyvsp[0].blk), '/');
 }
-#line 2747 "src/parser.c"
+#line 2752 "src/parser.c"
     break;
 
   case 31: /* Expr: Expr "%=" Expr  */
-#line 394 "src/parser.y"
+#line 399 "src/parser.y"
                  {
   (yyval.blk) = gen_update((yyvsp[-2].blk), (yyvsp[0].blk), '%');
 }
-#line 2755 "src/parser.c"
+#line 2760 "src/parser.c"
     break;
 
   case 32: /* Expr: Expr "==" Expr  */
-#line 397 "src/parser.y"
+#line 402 "src/parser.y"
                {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), EQ);
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), EQ));
 }
-#line 2763 "src/parser.c"
+#line 2768 "src/parser.c"
     break;
 
   case 33: /* Expr: Expr "!=" Expr  */
-#line 400 "src/parser.y"
+#line 405 "src/parser.y"
                {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), NEQ);
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), NEQ));
 }
-#line 2771 "src/parser.c"
+#line 2776 "src/parser.c"
     break;
 
   case 34: /* Expr: Expr '<' Expr  */
-#line 403 "src/parser.y"
+#line 408 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '<');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '<'));
 }
-#line 2779 "src/parser.c"
+#line 2784 "src/parser.c"
     break;
 
   case 35: /* Expr: Expr '>' Expr  */
-#line 406 "src/parser.y"
+#line 411 "src/parser.y"
               {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '>');
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), '>'));
 }
-#line 2787 "src/parser.c"
+#line 2792 "src/parser.c"
     break;
 
   case 36: /* Expr: Expr "<=" Expr  */
-#line 409 "src/parser.y"
+#line 414 "src/parser.y"
                {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), LESSEQ);
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), LESSEQ));
 }
-#line 2795 "src/parser.c"
+#line 2800 "src/parser.c"
     break;
 
   case 37: /* Expr: Expr ">=" Expr  */
-#line 412 "src/parser.y"
+#line 417 "src/parser.y"
                {
-  (yyval.blk) = gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), GREATEREQ);
+  (yyval.blk) = gen_location((yyloc), locations, gen_binop((yyvsp[-2].blk), (yyvsp[0].blk), GREATEREQ));
 }
-#line 2803 "src/parser.c"
+#line 2808 "src/parser.c"
     break;
 
   case 38: /* Expr: Term  */
-#line 415 "src/parser.y"
+#line 420 "src/parser.y"
                   {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 2811 "src/parser.c"
+#line 2816 "src/parser.c"
     break;
 
   case 39: /* Import: ImportWhat ';'  */
-#line 421 "src/parser.y"
+#line 426 "src/parser.y"
                {
   (yyval.blk) = (yyvsp[-1].blk);
 }
-#line 2819 "src/parser.c"
+#line 2824 "src/parser.c"
     break;
 
   case 40: /* Import: ImportWhat Query ';'  */
-#line 424 "src/parser.y"
+#line 429 "src/parser.y"
                      {
   if (!block_is_const((yyvsp[-1].blk))) {
     FAIL((yylsp[-1]), "Module metadata must be constant");
@@ -2835,38 +2840,38 @@ yyreduce:
     (yyval.blk) = gen_import_meta((yyvsp[-2].blk), (yyvsp[-1].blk));
   }
 }
-#line 2839 "src/parser.c"
+#line 2844 "src/parser.c"
     break;
 
   case 41: /* ImportWhat: "import" ImportFrom "as" BINDING  */
-#line 441 "src/parser.y"
+#line 446 "src/parser.y"
                                  {
   (yyval.blk) = gen_import(block_const((yyvsp[-2].blk)), (yyvsp[0].literal), 1);
   block_free((yyvsp[-2].blk));
 }
-#line 2848 "src/parser.c"
+#line 2853 "src/parser.c"
     break;
 
   case 42: /* ImportWhat: "import" ImportFrom "as" IDENT  */
-#line 445 "src/parser.y"
+#line 450 "src/parser.y"
                                {
   (yyval.blk) = gen_import(block_const((yyvsp[-2].blk)), (yyvsp[0].literal), 0);
   block_free((yyvsp[-2].blk));
 }
-#line 2857 "src/parser.c"
+#line 2862 "src/parser.c"
     break;
 
   case 43: /* ImportWhat: "include" ImportFrom  */
-#line 449 "src/parser.y"
+#line 454 "src/parser.y"
                      {
   (yyval.blk) = gen_import(block_const((yyvsp[0].blk)), jv_invalid(), 0);
   block_free((yyvsp[0].blk));
 }
-#line 2866 "src/parser.c"
+#line 2871 "src/parser.c"
     break;
 
   case 44: /* ImportFrom: String  */
-#line 455 "src/parser.y"
+#line 460 "src/parser.y"
        {
   if (!block_is_const((yyvsp[0].blk))) {
     FAIL((yylsp[0]), "Import path must be constant");
@@ -2876,152 +2881,152 @@ yyreduce:
     (yyval.blk) = (yyvsp[0].blk);
   }
 }
-#line 2880 "src/parser.c"
+#line 2885 "src/parser.c"
     break;
 
   case 45: /* FuncDef: "def" IDENT ':' Query ';'  */
-#line 466 "src/parser.y"
+#line 471 "src/parser.y"
                           {
   (yyval.blk) = gen_function(jv_string_value((yyvsp[-3].literal)), gen_noop(), (yyvsp[-1].blk));
   jv_free((yyvsp[-3].literal));
 }
-#line 2889 "src/parser.c"
+#line 2894 "src/parser.c"
     break;
 
   case 46: /* FuncDef: "def" IDENT '(' Params ')' ':' Query ';'  */
-#line 471 "src/parser.y"
+#line 476 "src/parser.y"
                                          {
   (yyval.blk) = gen_function(jv_string_value((yyvsp[-6].literal)), (yyvsp[-4].blk), (yyvsp[-1].blk));
   jv_free((yyvsp[-6].literal));
 }
-#line 2898 "src/parser.c"
+#line 2903 "src/parser.c"
     break;
 
   case 47: /* Params: Param  */
-#line 477 "src/parser.y"
+#line 482 "src/parser.y"
       {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 2906 "src/parser.c"
+#line 2911 "src/parser.c"
     break;
 
   case 48: /* Params: Params ';' Param  */
-#line 480 "src/parser.y"
+#line 485 "src/parser.y"
                  {
   (yyval.blk) = BLOCK((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 2914 "src/parser.c"
+#line 2919 "src/parser.c"
     break;
 
   case 49: /* Param: BINDING  */
-#line 485 "src/parser.y"
+#line 490 "src/parser.y"
         {
   (yyval.blk) = gen_param_regular(jv_string_value((yyvsp[0].literal)));
   jv_free((yyvsp[0].literal));
 }
-#line 2923 "src/parser.c"
+#line 2928 "src/parser.c"
     break;
 
   case 50: /* Param: IDENT  */
-#line 489 "src/parser.y"
+#line 494 "src/parser.y"
       {
   (yyval.blk) = gen_param(jv_string_value((yyvsp[0].literal)));
   jv_free((yyvsp[0].literal));
 }
-#line 2932 "src/parser.c"
+#line 2937 "src/parser.c"
     break;
 
   case 51: /* StringStart: FORMAT QQSTRING_START  */
-#line 496 "src/parser.y"
+#line 501 "src/parser.y"
                       {
   (yyval.literal) = (yyvsp[-1].literal);
 }
-#line 2940 "src/parser.c"
+#line 2945 "src/parser.c"
     break;
 
   case 52: /* StringStart: QQSTRING_START  */
-#line 499 "src/parser.y"
+#line 504 "src/parser.y"
                {
   (yyval.literal) = jv_string("text");
 }
-#line 2948 "src/parser.c"
+#line 2953 "src/parser.c"
     break;
 
   case 53: /* String: StringStart QQString QQSTRING_END  */
-#line 505 "src/parser.y"
+#line 510 "src/parser.y"
                                   {
   (yyval.blk) = (yyvsp[-1].blk);
   jv_free((yyvsp[-2].literal));
 }
-#line 2957 "src/parser.c"
+#line 2962 "src/parser.c"
     break;
 
   case 54: /* QQString: %empty  */
-#line 512 "src/parser.y"
+#line 517 "src/parser.y"
        {
   (yyval.blk) = gen_const(jv_string(""));
 }
-#line 2965 "src/parser.c"
+#line 2970 "src/parser.c"
     break;
 
   case 55: /* QQString: QQString QQSTRING_TEXT  */
-#line 515 "src/parser.y"
+#line 520 "src/parser.y"
                        {
   (yyval.blk) = gen_binop((yyvsp[-1].blk), gen_const((yyvsp[0].literal)), '+');
 }
-#line 2973 "src/parser.c"
+#line 2978 "src/parser.c"
     break;
 
   case 56: /* QQString: QQString QQSTRING_INTERP_START Query QQSTRING_INTERP_END  */
-#line 518 "src/parser.y"
+#line 523 "src/parser.y"
                                                          {
   (yyval.blk) = gen_binop((yyvsp[-3].blk), gen_format((yyvsp[-1].blk), jv_copy((yyvsp[-4].literal))), '+');
 }
-#line 2981 "src/parser.c"
+#line 2986 "src/parser.c"
     break;
 
   case 57: /* ElseBody: "elif" Query "then" Query ElseBody  */
-#line 524 "src/parser.y"
+#line 529 "src/parser.y"
                                    {
   (yyval.blk) = gen_cond((yyvsp[-3].blk), (yyvsp[-1].blk), (yyvsp[0].blk));
 }
-#line 2989 "src/parser.c"
+#line 2994 "src/parser.c"
     break;
 
   case 58: /* ElseBody: "else" Query "end"  */
-#line 527 "src/parser.y"
+#line 532 "src/parser.y"
                    {
   (yyval.blk) = (yyvsp[-1].blk);
 }
-#line 2997 "src/parser.c"
+#line 3002 "src/parser.c"
     break;
 
   case 59: /* ElseBody: "end"  */
-#line 530 "src/parser.y"
+#line 535 "src/parser.y"
       {
   (yyval.blk) = gen_noop();
 }
-#line 3005 "src/parser.c"
+#line 3010 "src/parser.c"
     break;
 
   case 60: /* Term: '.'  */
-#line 536 "src/parser.y"
+#line 541 "src/parser.y"
     {
   (yyval.blk) = gen_noop();
 }
-#line 3013 "src/parser.c"
+#line 3018 "src/parser.c"
     break;
 
   case 61: /* Term: ".."  */
-#line 539 "src/parser.y"
+#line 544 "src/parser.y"
     {
   (yyval.blk) = gen_call("recurse", gen_noop());
 }
-#line 3021 "src/parser.c"
+#line 3026 "src/parser.c"
     break;
 
   case 62: /* Term: "break" BINDING  */
-#line 542 "src/parser.y"
+#line 547 "src/parser.y"
               {
   jv v = jv_string_fmt("*label-%s", jv_string_value((yyvsp[0].literal)));     // impossible symbol
   (yyval.blk) = gen_location((yyloc), locations,
@@ -3030,279 +3035,279 @@ yyreduce:
   jv_free(v);
   jv_free((yyvsp[0].literal));
 }
-#line 3034 "src/parser.c"
+#line 3039 "src/parser.c"
     break;
 
   case 63: /* Term: "break" error  */
-#line 550 "src/parser.y"
+#line 555 "src/parser.y"
             {
   FAIL((yyloc), "break requires a label to break to");
   (yyval.blk) = gen_noop();
 }
-#line 3043 "src/parser.c"
+#line 3048 "src/parser.c"
     break;
 
   case 64: /* Term: Term FIELD '?'  */
-#line 554 "src/parser.y"
+#line 559 "src/parser.y"
                {
   (yyval.blk) = gen_index_opt((yyvsp[-2].blk), gen_const((yyvsp[-1].literal)));
 }
-#line 3051 "src/parser.c"
+#line 3056 "src/parser.c"
     break;
 
   case 65: /* Term: FIELD '?'  */
-#line 557 "src/parser.y"
+#line 562 "src/parser.y"
           {
   (yyval.blk) = gen_index_opt(gen_noop(), gen_const((yyvsp[-1].literal)));
 }
-#line 3059 "src/parser.c"
+#line 3064 "src/parser.c"
     break;
 
   case 66: /* Term: Term '.' String '?'  */
-#line 560 "src/parser.y"
+#line 565 "src/parser.y"
                     {
   (yyval.blk) = gen_index_opt((yyvsp[-3].blk), (yyvsp[-1].blk));
 }
-#line 3067 "src/parser.c"
+#line 3072 "src/parser.c"
     break;
 
   case 67: /* Term: '.' String '?'  */
-#line 563 "src/parser.y"
+#line 568 "src/parser.y"
                {
   (yyval.blk) = gen_index_opt(gen_noop(), (yyvsp[-1].blk));
 }
-#line 3075 "src/parser.c"
+#line 3080 "src/parser.c"
     break;
 
   case 68: /* Term: Term FIELD  */
-#line 566 "src/parser.y"
+#line 571 "src/parser.y"
                         {
   (yyval.blk) = gen_index((yyvsp[-1].blk), gen_const((yyvsp[0].literal)));
 }
-#line 3083 "src/parser.c"
+#line 3088 "src/parser.c"
     break;
 
   case 69: /* Term: FIELD  */
-#line 569 "src/parser.y"
+#line 574 "src/parser.y"
                    {
   (yyval.blk) = gen_index(gen_noop(), gen_const((yyvsp[0].literal)));
 }
-#line 3091 "src/parser.c"
+#line 3096 "src/parser.c"
     break;
 
   case 70: /* Term: Term '.' String  */
-#line 572 "src/parser.y"
+#line 577 "src/parser.y"
                              {
   (yyval.blk) = gen_index((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3099 "src/parser.c"
+#line 3104 "src/parser.c"
     break;
 
   case 71: /* Term: '.' String  */
-#line 575 "src/parser.y"
+#line 580 "src/parser.y"
                         {
   (yyval.blk) = gen_index(gen_noop(), (yyvsp[0].blk));
 }
-#line 3107 "src/parser.c"
+#line 3112 "src/parser.c"
     break;
 
   case 72: /* Term: '.' error  */
-#line 578 "src/parser.y"
+#line 583 "src/parser.y"
           {
   FAIL((yyloc), "try .[\"field\"] instead of .field for unusually named fields");
   (yyval.blk) = gen_noop();
 }
-#line 3116 "src/parser.c"
+#line 3121 "src/parser.c"
     break;
 
   case 73: /* Term: '.' IDENT error  */
-#line 582 "src/parser.y"
+#line 587 "src/parser.y"
                 {
   jv_free((yyvsp[-1].literal));
   FAIL((yyloc), "try .[\"field\"] instead of .field for unusually named fields");
   (yyval.blk) = gen_noop();
 }
-#line 3126 "src/parser.c"
+#line 3131 "src/parser.c"
     break;
 
   case 74: /* Term: Term '[' Query ']' '?'  */
-#line 588 "src/parser.y"
+#line 593 "src/parser.y"
                        {
   (yyval.blk) = gen_index_opt((yyvsp[-4].blk), (yyvsp[-2].blk));
 }
-#line 3134 "src/parser.c"
+#line 3139 "src/parser.c"
     break;
 
   case 75: /* Term: Term '[' Query ']'  */
-#line 591 "src/parser.y"
+#line 596 "src/parser.y"
                                 {
   (yyval.blk) = gen_index((yyvsp[-3].blk), (yyvsp[-1].blk));
 }
-#line 3142 "src/parser.c"
+#line 3147 "src/parser.c"
     break;
 
   case 76: /* Term: Term '.' '[' Query ']' '?'  */
-#line 594 "src/parser.y"
+#line 599 "src/parser.y"
                            {
   (yyval.blk) = gen_index_opt((yyvsp[-5].blk), (yyvsp[-2].blk));
 }
-#line 3150 "src/parser.c"
+#line 3155 "src/parser.c"
     break;
 
   case 77: /* Term: Term '.' '[' Query ']'  */
-#line 597 "src/parser.y"
+#line 602 "src/parser.y"
                                     {
   (yyval.blk) = gen_index((yyvsp[-4].blk), (yyvsp[-1].blk));
 }
-#line 3158 "src/parser.c"
+#line 3163 "src/parser.c"
     break;
 
   case 78: /* Term: Term '[' ']' '?'  */
-#line 600 "src/parser.y"
+#line 605 "src/parser.y"
                  {
   (yyval.blk) = block_join((yyvsp[-3].blk), gen_op_simple(EACH_OPT));
 }
-#line 3166 "src/parser.c"
+#line 3171 "src/parser.c"
     break;
 
   case 79: /* Term: Term '[' ']'  */
-#line 603 "src/parser.y"
+#line 608 "src/parser.y"
                           {
   (yyval.blk) = block_join((yyvsp[-2].blk), gen_op_simple(EACH));
 }
-#line 3174 "src/parser.c"
+#line 3179 "src/parser.c"
     break;
 
   case 80: /* Term: Term '.' '[' ']' '?'  */
-#line 606 "src/parser.y"
+#line 611 "src/parser.y"
                      {
   (yyval.blk) = block_join((yyvsp[-4].blk), gen_op_simple(EACH_OPT));
 }
-#line 3182 "src/parser.c"
+#line 3187 "src/parser.c"
     break;
 
   case 81: /* Term: Term '.' '[' ']'  */
-#line 609 "src/parser.y"
+#line 614 "src/parser.y"
                               {
   (yyval.blk) = block_join((yyvsp[-3].blk), gen_op_simple(EACH));
 }
-#line 3190 "src/parser.c"
+#line 3195 "src/parser.c"
     break;
 
   case 82: /* Term: Term '[' Query ':' Query ']' '?'  */
-#line 612 "src/parser.y"
+#line 617 "src/parser.y"
                                  {
   (yyval.blk) = gen_slice_index((yyvsp[-6].blk), (yyvsp[-4].blk), (yyvsp[-2].blk), INDEX_OPT);
 }
-#line 3198 "src/parser.c"
+#line 3203 "src/parser.c"
     break;
 
   case 83: /* Term: Term '[' Query ':' ']' '?'  */
-#line 615 "src/parser.y"
+#line 620 "src/parser.y"
                            {
   (yyval.blk) = gen_slice_index((yyvsp[-5].blk), (yyvsp[-3].blk), gen_const(jv_null()), INDEX_OPT);
 }
-#line 3206 "src/parser.c"
+#line 3211 "src/parser.c"
     break;
 
   case 84: /* Term: Term '[' ':' Query ']' '?'  */
-#line 618 "src/parser.y"
+#line 623 "src/parser.y"
                            {
   (yyval.blk) = gen_slice_index((yyvsp[-5].blk), gen_const(jv_null()), (yyvsp[-2].blk), INDEX_OPT);
 }
-#line 3214 "src/parser.c"
+#line 3219 "src/parser.c"
     break;
 
   case 85: /* Term: Term '[' Query ':' Query ']'  */
-#line 621 "src/parser.y"
+#line 626 "src/parser.y"
                                           {
   (yyval.blk) = gen_slice_index((yyvsp[-5].blk), (yyvsp[-3].blk), (yyvsp[-1].blk), INDEX);
 }
-#line 3222 "src/parser.c"
+#line 3227 "src/parser.c"
     break;
 
   case 86: /* Term: Term '[' Query ':' ']'  */
-#line 624 "src/parser.y"
+#line 629 "src/parser.y"
                                     {
   (yyval.blk) = gen_slice_index((yyvsp[-4].blk), (yyvsp[-2].blk), gen_const(jv_null()), INDEX);
 }
-#line 3230 "src/parser.c"
+#line 3235 "src/parser.c"
     break;
 
   case 87: /* Term: Term '[' ':' Query ']'  */
-#line 627 "src/parser.y"
+#line 632 "src/parser.y"
                                     {
   (yyval.blk) = gen_slice_index((yyvsp[-4].blk), gen_const(jv_null()), (yyvsp[-1].blk), INDEX);
 }
-#line 3238 "src/parser.c"
+#line 3243 "src/parser.c"
     break;
 
   case 88: /* Term: Term '?'  */
-#line 630 "src/parser.y"
+#line 635 "src/parser.y"
          {
   (yyval.blk) = gen_try((yyvsp[-1].blk), gen_op_simple(BACKTRACK));
 }
-#line 3246 "src/parser.c"
+#line 3251 "src/parser.c"
     break;
 
   case 89: /* Term: LITERAL  */
-#line 633 "src/parser.y"
+#line 638 "src/parser.y"
         {
   (yyval.blk) = gen_const((yyvsp[0].literal));
 }
-#line 3254 "src/parser.c"
+#line 3259 "src/parser.c"
     break;
 
   case 90: /* Term: String  */
-#line 636 "src/parser.y"
+#line 641 "src/parser.y"
        {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3262 "src/parser.c"
+#line 3267 "src/parser.c"
     break;
 
   case 91: /* Term: FORMAT  */
-#line 639 "src/parser.y"
+#line 644 "src/parser.y"
        {
   (yyval.blk) = gen_format(gen_noop(), (yyvsp[0].literal));
 }
-#line 3270 "src/parser.c"
+#line 3275 "src/parser.c"
     break;
 
   case 92: /* Term: '-' Term  */
-#line 642 "src/parser.y"
+#line 647 "src/parser.y"
          {
   (yyval.blk) = BLOCK((yyvsp[0].blk), gen_call("_negate", gen_noop()));
 }
-#line 3278 "src/parser.c"
+#line 3283 "src/parser.c"
     break;
 
   case 93: /* Term: '(' Query ')'  */
-#line 645 "src/parser.y"
+#line 650 "src/parser.y"
               {
   (yyval.blk) = (yyvsp[-1].blk);
 }
-#line 3286 "src/parser.c"
+#line 3291 "src/parser.c"
     break;
 
   case 94: /* Term: '[' Query ']'  */
-#line 648 "src/parser.y"
+#line 653 "src/parser.y"
               {
   (yyval.blk) = gen_collect((yyvsp[-1].blk));
 }
-#line 3294 "src/parser.c"
+#line 3299 "src/parser.c"
     break;
 
   case 95: /* Term: '[' ']'  */
-#line 651 "src/parser.y"
+#line 656 "src/parser.y"
         {
   (yyval.blk) = gen_const(jv_array());
 }
-#line 3302 "src/parser.c"
+#line 3307 "src/parser.c"
     break;
 
   case 96: /* Term: '{' DictPairs '}'  */
-#line 654 "src/parser.y"
+#line 659 "src/parser.y"
                   {
   block o = gen_const_object((yyvsp[-1].blk));
   if (o.first != NULL)
@@ -3310,103 +3315,103 @@ yyreduce:
   else
     (yyval.blk) = BLOCK(gen_subexp(gen_const(jv_object())), (yyvsp[-1].blk), gen_op_simple(POP));
 }
-#line 3314 "src/parser.c"
+#line 3319 "src/parser.c"
     break;
 
   case 97: /* Term: "reduce" Expr "as" Patterns '(' Query ';' Query ')'  */
-#line 661 "src/parser.y"
+#line 666 "src/parser.y"
                                                     {
   (yyval.blk) = gen_reduce((yyvsp[-7].blk), (yyvsp[-5].blk), (yyvsp[-3].blk), (yyvsp[-1].blk));
 }
-#line 3322 "src/parser.c"
+#line 3327 "src/parser.c"
     break;
 
   case 98: /* Term: "foreach" Expr "as" Patterns '(' Query ';' Query ';' Query ')'  */
-#line 664 "src/parser.y"
+#line 669 "src/parser.y"
                                                                {
   (yyval.blk) = gen_foreach((yyvsp[-9].blk), (yyvsp[-7].blk), (yyvsp[-5].blk), (yyvsp[-3].blk), (yyvsp[-1].blk));
 }
-#line 3330 "src/parser.c"
+#line 3335 "src/parser.c"
     break;
 
   case 99: /* Term: "foreach" Expr "as" Patterns '(' Query ';' Query ')'  */
-#line 667 "src/parser.y"
+#line 672 "src/parser.y"
                                                      {
   (yyval.blk) = gen_foreach((yyvsp[-7].blk), (yyvsp[-5].blk), (yyvsp[-3].blk), (yyvsp[-1].blk), gen_noop());
 }
-#line 3338 "src/parser.c"
+#line 3343 "src/parser.c"
     break;
 
   case 100: /* Term: "if" Query "then" Query ElseBody  */
-#line 670 "src/parser.y"
+#line 675 "src/parser.y"
                                  {
   (yyval.blk) = gen_cond((yyvsp[-3].blk), (yyvsp[-1].blk), (yyvsp[0].blk));
 }
-#line 3346 "src/parser.c"
+#line 3351 "src/parser.c"
     break;
 
   case 101: /* Term: "if" Query "then" error  */
-#line 673 "src/parser.y"
+#line 678 "src/parser.y"
                         {
   FAIL((yyloc), "Possibly unterminated 'if' statement");
   (yyval.blk) = (yyvsp[-2].blk);
 }
-#line 3355 "src/parser.c"
+#line 3360 "src/parser.c"
     break;
 
   case 102: /* Term: "try" Expr "catch" Expr  */
-#line 677 "src/parser.y"
+#line 682 "src/parser.y"
                         {
   (yyval.blk) = gen_try((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3363 "src/parser.c"
+#line 3368 "src/parser.c"
     break;
 
   case 103: /* Term: "try" Expr "catch" error  */
-#line 680 "src/parser.y"
+#line 685 "src/parser.y"
                          {
   FAIL((yyloc), "Possibly unterminated 'try' statement");
   (yyval.blk) = (yyvsp[-2].blk);
 }
-#line 3372 "src/parser.c"
+#line 3377 "src/parser.c"
     break;
 
   case 104: /* Term: "try" Expr  */
-#line 684 "src/parser.y"
+#line 689 "src/parser.y"
            {
   (yyval.blk) = gen_try((yyvsp[0].blk), gen_op_simple(BACKTRACK));
 }
-#line 3380 "src/parser.c"
+#line 3385 "src/parser.c"
     break;
 
   case 105: /* Term: '$' '$' '$' BINDING  */
-#line 702 "src/parser.y"
+#line 707 "src/parser.y"
                     {
   (yyval.blk) = gen_location((yyloc), locations, gen_op_unbound(LOADVN, jv_string_value((yyvsp[0].literal))));
   jv_free((yyvsp[0].literal));
 }
-#line 3389 "src/parser.c"
+#line 3394 "src/parser.c"
     break;
 
   case 106: /* Term: BINDING  */
-#line 706 "src/parser.y"
+#line 711 "src/parser.y"
         {
   (yyval.blk) = gen_location((yyloc), locations, gen_op_unbound(LOADV, jv_string_value((yyvsp[0].literal))));
   jv_free((yyvsp[0].literal));
 }
-#line 3398 "src/parser.c"
+#line 3403 "src/parser.c"
     break;
 
   case 107: /* Term: "$__loc__"  */
-#line 710 "src/parser.y"
+#line 715 "src/parser.y"
            {
   (yyval.blk) = gen_loc_object(&(yyloc), locations);
 }
-#line 3406 "src/parser.c"
+#line 3411 "src/parser.c"
     break;
 
   case 108: /* Term: IDENT  */
-#line 713 "src/parser.y"
+#line 718 "src/parser.y"
       {
   const char *s = jv_string_value((yyvsp[0].literal));
   if (strcmp(s, "false") == 0)
@@ -3419,198 +3424,198 @@ yyreduce:
     (yyval.blk) = gen_location((yyloc), locations, gen_call(s, gen_noop()));
   jv_free((yyvsp[0].literal));
 }
-#line 3423 "src/parser.c"
+#line 3428 "src/parser.c"
     break;
 
   case 109: /* Term: IDENT '(' Args ')'  */
-#line 725 "src/parser.y"
+#line 730 "src/parser.y"
                    {
   (yyval.blk) = gen_call(jv_string_value((yyvsp[-3].literal)), (yyvsp[-1].blk));
   (yyval.blk) = gen_location((yylsp[-3]), locations, (yyval.blk));
   jv_free((yyvsp[-3].literal));
 }
-#line 3433 "src/parser.c"
+#line 3438 "src/parser.c"
     break;
 
   case 110: /* Term: '(' error ')'  */
-#line 730 "src/parser.y"
+#line 735 "src/parser.y"
               { (yyval.blk) = gen_noop(); }
-#line 3439 "src/parser.c"
+#line 3444 "src/parser.c"
     break;
 
   case 111: /* Term: '[' error ']'  */
-#line 731 "src/parser.y"
+#line 736 "src/parser.y"
               { (yyval.blk) = gen_noop(); }
-#line 3445 "src/parser.c"
+#line 3450 "src/parser.c"
     break;
 
   case 112: /* Term: Term '[' error ']'  */
-#line 732 "src/parser.y"
+#line 737 "src/parser.y"
                    { (yyval.blk) = (yyvsp[-3].blk); }
-#line 3451 "src/parser.c"
+#line 3456 "src/parser.c"
     break;
 
   case 113: /* Term: '{' error '}'  */
-#line 733 "src/parser.y"
+#line 738 "src/parser.y"
               { (yyval.blk) = gen_noop(); }
-#line 3457 "src/parser.c"
+#line 3462 "src/parser.c"
     break;
 
   case 114: /* Args: Arg  */
-#line 736 "src/parser.y"
+#line 741 "src/parser.y"
     {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3465 "src/parser.c"
+#line 3470 "src/parser.c"
     break;
 
   case 115: /* Args: Args ';' Arg  */
-#line 739 "src/parser.y"
+#line 744 "src/parser.y"
              {
   (yyval.blk) = BLOCK((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3473 "src/parser.c"
+#line 3478 "src/parser.c"
     break;
 
   case 116: /* Arg: Query  */
-#line 744 "src/parser.y"
+#line 749 "src/parser.y"
       {
   (yyval.blk) = gen_lambda((yyvsp[0].blk));
 }
-#line 3481 "src/parser.c"
+#line 3486 "src/parser.c"
     break;
 
   case 117: /* RepPatterns: RepPatterns "?//" Pattern  */
-#line 749 "src/parser.y"
+#line 754 "src/parser.y"
                           {
   (yyval.blk) = BLOCK((yyvsp[-2].blk), gen_destructure_alt((yyvsp[0].blk)));
 }
-#line 3489 "src/parser.c"
+#line 3494 "src/parser.c"
     break;
 
   case 118: /* RepPatterns: Pattern  */
-#line 752 "src/parser.y"
+#line 757 "src/parser.y"
         {
   (yyval.blk) = gen_destructure_alt((yyvsp[0].blk));
 }
-#line 3497 "src/parser.c"
+#line 3502 "src/parser.c"
     break;
 
   case 119: /* Patterns: RepPatterns "?//" Pattern  */
-#line 757 "src/parser.y"
+#line 762 "src/parser.y"
                           {
   (yyval.blk) = BLOCK((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3505 "src/parser.c"
+#line 3510 "src/parser.c"
     break;
 
   case 120: /* Patterns: Pattern  */
-#line 760 "src/parser.y"
+#line 765 "src/parser.y"
         {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3513 "src/parser.c"
+#line 3518 "src/parser.c"
     break;
 
   case 121: /* Pattern: BINDING  */
-#line 765 "src/parser.y"
+#line 770 "src/parser.y"
         {
   (yyval.blk) = gen_op_unbound(STOREV, jv_string_value((yyvsp[0].literal)));
   jv_free((yyvsp[0].literal));
 }
-#line 3522 "src/parser.c"
+#line 3527 "src/parser.c"
     break;
 
   case 122: /* Pattern: '[' ArrayPats ']'  */
-#line 769 "src/parser.y"
+#line 774 "src/parser.y"
                   {
   (yyval.blk) = BLOCK((yyvsp[-1].blk), gen_op_simple(POP));
 }
-#line 3530 "src/parser.c"
+#line 3535 "src/parser.c"
     break;
 
   case 123: /* Pattern: '{' ObjPats '}'  */
-#line 772 "src/parser.y"
+#line 777 "src/parser.y"
                 {
   (yyval.blk) = BLOCK((yyvsp[-1].blk), gen_op_simple(POP));
 }
-#line 3538 "src/parser.c"
+#line 3543 "src/parser.c"
     break;
 
   case 124: /* ArrayPats: Pattern  */
-#line 777 "src/parser.y"
+#line 782 "src/parser.y"
         {
   (yyval.blk) = gen_array_matcher(gen_noop(), (yyvsp[0].blk));
 }
-#line 3546 "src/parser.c"
+#line 3551 "src/parser.c"
     break;
 
   case 125: /* ArrayPats: ArrayPats ',' Pattern  */
-#line 780 "src/parser.y"
+#line 785 "src/parser.y"
                       {
   (yyval.blk) = gen_array_matcher((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3554 "src/parser.c"
+#line 3559 "src/parser.c"
     break;
 
   case 126: /* ObjPats: ObjPat  */
-#line 785 "src/parser.y"
+#line 790 "src/parser.y"
        {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3562 "src/parser.c"
+#line 3567 "src/parser.c"
     break;
 
   case 127: /* ObjPats: ObjPats ',' ObjPat  */
-#line 788 "src/parser.y"
+#line 793 "src/parser.y"
                    {
   (yyval.blk) = BLOCK((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3570 "src/parser.c"
+#line 3575 "src/parser.c"
     break;
 
   case 128: /* ObjPat: BINDING  */
-#line 793 "src/parser.y"
+#line 798 "src/parser.y"
         {
   (yyval.blk) = gen_object_matcher(gen_const((yyvsp[0].literal)), gen_op_unbound(STOREV, jv_string_value((yyvsp[0].literal))));
 }
-#line 3578 "src/parser.c"
+#line 3583 "src/parser.c"
     break;
 
   case 129: /* ObjPat: BINDING ':' Pattern  */
-#line 796 "src/parser.y"
+#line 801 "src/parser.y"
                     {
   (yyval.blk) = gen_object_matcher(gen_const((yyvsp[-2].literal)), BLOCK(gen_op_simple(DUP), gen_op_unbound(STOREV, jv_string_value((yyvsp[-2].literal))), (yyvsp[0].blk)));
 }
-#line 3586 "src/parser.c"
+#line 3591 "src/parser.c"
     break;
 
   case 130: /* ObjPat: IDENT ':' Pattern  */
-#line 799 "src/parser.y"
+#line 804 "src/parser.y"
                   {
   (yyval.blk) = gen_object_matcher(gen_const((yyvsp[-2].literal)), (yyvsp[0].blk));
 }
-#line 3594 "src/parser.c"
+#line 3599 "src/parser.c"
     break;
 
   case 131: /* ObjPat: Keyword ':' Pattern  */
-#line 802 "src/parser.y"
+#line 807 "src/parser.y"
                     {
   (yyval.blk) = gen_object_matcher(gen_const((yyvsp[-2].literal)), (yyvsp[0].blk));
 }
-#line 3602 "src/parser.c"
+#line 3607 "src/parser.c"
     break;
 
   case 132: /* ObjPat: String ':' Pattern  */
-#line 805 "src/parser.y"
+#line 810 "src/parser.y"
                    {
   (yyval.blk) = gen_object_matcher((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3610 "src/parser.c"
+#line 3615 "src/parser.c"
     break;
 
   case 133: /* ObjPat: '(' Query ')' ':' Pattern  */
-#line 808 "src/parser.y"
+#line 813 "src/parser.y"
                           {
   jv msg = check_object_key((yyvsp[-3].blk));
   if (jv_is_valid(msg)) {
@@ -3619,267 +3624,267 @@ yyreduce:
   jv_free(msg);
   (yyval.blk) = gen_object_matcher((yyvsp[-3].blk), (yyvsp[0].blk));
 }
-#line 3623 "src/parser.c"
+#line 3628 "src/parser.c"
     break;
 
   case 134: /* ObjPat: error ':' Pattern  */
-#line 816 "src/parser.y"
+#line 821 "src/parser.y"
                   {
   FAIL((yyloc), "May need parentheses around object key expression");
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3632 "src/parser.c"
+#line 3637 "src/parser.c"
     break;
 
   case 135: /* Keyword: "as"  */
-#line 822 "src/parser.y"
+#line 827 "src/parser.y"
      {
   (yyval.literal) = jv_string("as");
 }
-#line 3640 "src/parser.c"
+#line 3645 "src/parser.c"
     break;
 
   case 136: /* Keyword: "def"  */
-#line 825 "src/parser.y"
+#line 830 "src/parser.y"
       {
   (yyval.literal) = jv_string("def");
 }
-#line 3648 "src/parser.c"
+#line 3653 "src/parser.c"
     break;
 
   case 137: /* Keyword: "module"  */
-#line 828 "src/parser.y"
+#line 833 "src/parser.y"
          {
   (yyval.literal) = jv_string("module");
 }
-#line 3656 "src/parser.c"
+#line 3661 "src/parser.c"
     break;
 
   case 138: /* Keyword: "import"  */
-#line 831 "src/parser.y"
+#line 836 "src/parser.y"
          {
   (yyval.literal) = jv_string("import");
 }
-#line 3664 "src/parser.c"
+#line 3669 "src/parser.c"
     break;
 
   case 139: /* Keyword: "include"  */
-#line 834 "src/parser.y"
+#line 839 "src/parser.y"
           {
   (yyval.literal) = jv_string("include");
 }
-#line 3672 "src/parser.c"
+#line 3677 "src/parser.c"
     break;
 
   case 140: /* Keyword: "if"  */
-#line 837 "src/parser.y"
+#line 842 "src/parser.y"
      {
   (yyval.literal) = jv_string("if");
 }
-#line 3680 "src/parser.c"
+#line 3685 "src/parser.c"
     break;
 
   case 141: /* Keyword: "then"  */
-#line 840 "src/parser.y"
+#line 845 "src/parser.y"
        {
   (yyval.literal) = jv_string("then");
 }
-#line 3688 "src/parser.c"
+#line 3693 "src/parser.c"
     break;
 
   case 142: /* Keyword: "else"  */
-#line 843 "src/parser.y"
+#line 848 "src/parser.y"
        {
   (yyval.literal) = jv_string("else");
 }
-#line 3696 "src/parser.c"
+#line 3701 "src/parser.c"
     break;
 
   case 143: /* Keyword: "elif"  */
-#line 846 "src/parser.y"
+#line 851 "src/parser.y"
        {
   (yyval.literal) = jv_string("elif");
 }
-#line 3704 "src/parser.c"
+#line 3709 "src/parser.c"
     break;
 
   case 144: /* Keyword: "reduce"  */
-#line 849 "src/parser.y"
+#line 854 "src/parser.y"
          {
   (yyval.literal) = jv_string("reduce");
 }
-#line 3712 "src/parser.c"
+#line 3717 "src/parser.c"
     break;
 
   case 145: /* Keyword: "foreach"  */
-#line 852 "src/parser.y"
+#line 857 "src/parser.y"
           {
   (yyval.literal) = jv_string("foreach");
 }
-#line 3720 "src/parser.c"
+#line 3725 "src/parser.c"
     break;
 
   case 146: /* Keyword: "end"  */
-#line 855 "src/parser.y"
+#line 860 "src/parser.y"
       {
   (yyval.literal) = jv_string("end");
 }
-#line 3728 "src/parser.c"
+#line 3733 "src/parser.c"
     break;
 
   case 147: /* Keyword: "and"  */
-#line 858 "src/parser.y"
+#line 863 "src/parser.y"
       {
   (yyval.literal) = jv_string("and");
 }
-#line 3736 "src/parser.c"
+#line 3741 "src/parser.c"
     break;
 
   case 148: /* Keyword: "or"  */
-#line 861 "src/parser.y"
+#line 866 "src/parser.y"
      {
   (yyval.literal) = jv_string("or");
 }
-#line 3744 "src/parser.c"
+#line 3749 "src/parser.c"
     break;
 
   case 149: /* Keyword: "try"  */
-#line 864 "src/parser.y"
+#line 869 "src/parser.y"
       {
   (yyval.literal) = jv_string("try");
 }
-#line 3752 "src/parser.c"
+#line 3757 "src/parser.c"
     break;
 
   case 150: /* Keyword: "catch"  */
-#line 867 "src/parser.y"
+#line 872 "src/parser.y"
         {
   (yyval.literal) = jv_string("catch");
 }
-#line 3760 "src/parser.c"
+#line 3765 "src/parser.c"
     break;
 
   case 151: /* Keyword: "label"  */
-#line 870 "src/parser.y"
+#line 875 "src/parser.y"
         {
   (yyval.literal) = jv_string("label");
 }
-#line 3768 "src/parser.c"
+#line 3773 "src/parser.c"
     break;
 
   case 152: /* Keyword: "break"  */
-#line 873 "src/parser.y"
+#line 878 "src/parser.y"
         {
   (yyval.literal) = jv_string("break");
 }
-#line 3776 "src/parser.c"
+#line 3781 "src/parser.c"
     break;
 
   case 153: /* DictPairs: %empty  */
-#line 879 "src/parser.y"
+#line 884 "src/parser.y"
        {
   (yyval.blk) = gen_noop();
 }
-#line 3784 "src/parser.c"
+#line 3789 "src/parser.c"
     break;
 
   case 154: /* DictPairs: DictPair  */
-#line 882 "src/parser.y"
+#line 887 "src/parser.y"
          {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3792 "src/parser.c"
+#line 3797 "src/parser.c"
     break;
 
   case 155: /* DictPairs: DictPair ',' DictPairs  */
-#line 885 "src/parser.y"
+#line 890 "src/parser.y"
                        {
   (yyval.blk) = block_join((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3800 "src/parser.c"
+#line 3805 "src/parser.c"
     break;
 
   case 156: /* DictPair: IDENT ':' DictExpr  */
-#line 890 "src/parser.y"
+#line 895 "src/parser.y"
                    {
   (yyval.blk) = gen_dictpair(gen_const((yyvsp[-2].literal)), (yyvsp[0].blk));
 }
-#line 3808 "src/parser.c"
+#line 3813 "src/parser.c"
     break;
 
   case 157: /* DictPair: Keyword ':' DictExpr  */
-#line 893 "src/parser.y"
+#line 898 "src/parser.y"
                      {
   (yyval.blk) = gen_dictpair(gen_const((yyvsp[-2].literal)), (yyvsp[0].blk));
 }
-#line 3816 "src/parser.c"
+#line 3821 "src/parser.c"
     break;
 
   case 158: /* DictPair: String ':' DictExpr  */
-#line 896 "src/parser.y"
+#line 901 "src/parser.y"
                     {
   (yyval.blk) = gen_dictpair((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3824 "src/parser.c"
+#line 3829 "src/parser.c"
     break;
 
   case 159: /* DictPair: String  */
-#line 899 "src/parser.y"
+#line 904 "src/parser.y"
        {
   (yyval.blk) = gen_dictpair((yyvsp[0].blk), BLOCK(gen_op_simple(POP), gen_op_simple(DUP2),
                               gen_op_simple(DUP2), gen_op_simple(INDEX)));
 }
-#line 3833 "src/parser.c"
+#line 3838 "src/parser.c"
     break;
 
   case 160: /* DictPair: BINDING ':' DictExpr  */
-#line 903 "src/parser.y"
+#line 908 "src/parser.y"
                      {
   (yyval.blk) = gen_dictpair(gen_location((yyloc), locations, gen_op_unbound(LOADV, jv_string_value((yyvsp[-2].literal)))),
                     (yyvsp[0].blk));
   jv_free((yyvsp[-2].literal));
 }
-#line 3843 "src/parser.c"
+#line 3848 "src/parser.c"
     break;
 
   case 161: /* DictPair: BINDING  */
-#line 908 "src/parser.y"
+#line 913 "src/parser.y"
         {
   (yyval.blk) = gen_dictpair(gen_const((yyvsp[0].literal)),
                     gen_location((yyloc), locations, gen_op_unbound(LOADV, jv_string_value((yyvsp[0].literal)))));
 }
-#line 3852 "src/parser.c"
+#line 3857 "src/parser.c"
     break;
 
   case 162: /* DictPair: IDENT  */
-#line 912 "src/parser.y"
+#line 917 "src/parser.y"
       {
   (yyval.blk) = gen_dictpair(gen_const(jv_copy((yyvsp[0].literal))),
                     gen_index(gen_noop(), gen_const((yyvsp[0].literal))));
 }
-#line 3861 "src/parser.c"
+#line 3866 "src/parser.c"
     break;
 
   case 163: /* DictPair: "$__loc__"  */
-#line 916 "src/parser.y"
+#line 921 "src/parser.y"
            {
   (yyval.blk) = gen_dictpair(gen_const(jv_string("__loc__")),
                     gen_loc_object(&(yyloc), locations));
 }
-#line 3870 "src/parser.c"
+#line 3875 "src/parser.c"
     break;
 
   case 164: /* DictPair: Keyword  */
-#line 920 "src/parser.y"
+#line 925 "src/parser.y"
         {
   (yyval.blk) = gen_dictpair(gen_const(jv_copy((yyvsp[0].literal))),
                     gen_index(gen_noop(), gen_const((yyvsp[0].literal))));
 }
-#line 3879 "src/parser.c"
+#line 3884 "src/parser.c"
     break;
 
   case 165: /* DictPair: '(' Query ')' ':' DictExpr  */
-#line 924 "src/parser.y"
+#line 929 "src/parser.y"
                            {
   jv msg = check_object_key((yyvsp[-3].blk));
   if (jv_is_valid(msg)) {
@@ -3888,36 +3893,36 @@ yyreduce:
   jv_free(msg);
   (yyval.blk) = gen_dictpair((yyvsp[-3].blk), (yyvsp[0].blk));
 }
-#line 3892 "src/parser.c"
+#line 3897 "src/parser.c"
     break;
 
   case 166: /* DictPair: error ':' DictExpr  */
-#line 932 "src/parser.y"
+#line 937 "src/parser.y"
                    {
   FAIL((yylsp[-2]), "May need parentheses around object key expression");
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3901 "src/parser.c"
+#line 3906 "src/parser.c"
     break;
 
   case 167: /* DictExpr: DictExpr '|' DictExpr  */
-#line 938 "src/parser.y"
+#line 943 "src/parser.y"
                       {
   (yyval.blk) = block_join((yyvsp[-2].blk), (yyvsp[0].blk));
 }
-#line 3909 "src/parser.c"
+#line 3914 "src/parser.c"
     break;
 
   case 168: /* DictExpr: Expr  */
-#line 941 "src/parser.y"
+#line 946 "src/parser.y"
      {
   (yyval.blk) = (yyvsp[0].blk);
 }
-#line 3917 "src/parser.c"
+#line 3922 "src/parser.c"
     break;
 
 
-#line 3921 "src/parser.c"
+#line 3926 "src/parser.c"
 
       default: break;
     }
@@ -4146,7 +4151,7 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 944 "src/parser.y"
+#line 949 "src/parser.y"
 
 
 int jq_parse(struct locfile* locations, block* answer) {
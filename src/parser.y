@@ -195,6 +195,11 @@ static block constant_fold(block a, block b, int op) {
   if (!block_is_single(a) || !block_is_const(a) ||
       !block_is_single(b) || !block_is_const(b))
     return gen_noop();
+  // Repeating a string can make a value of any size, which is better
+  // left to run time, where --limit applies
+  if (op == '*' &&
+      (block_const_kind(a) == JV_KIND_STRING || block_const_kind(b) == JV_KIND_STRING))
+    return gen_noop();
 
   jv jv_a = block_const(a);
   block_free(a);
@@ -365,28 +370,28 @@ Expr "|=" Expr {
   $$ = gen_call("_modify", BLOCK(gen_lambda($1), gen_lambda($3)));
 } |
 Expr '+' Expr {
-  $$ = gen_binop($1, $3, '+');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '+'));
 } |
 Expr "+=" Expr {
   $$ = gen_update($1, $3, '+');
 } |
 Expr '-' Expr {
-  $$ = gen_binop($1, $3, '-');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '-'));
 } |
 Expr "-=" Expr {
   $$ = gen_update($1, $3, '-');
 } |
 Expr '*' Expr {
-  $$ = gen_binop($1, $3, '*');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '*'));
 } |
 Expr "*=" Expr {
   $$ = gen_update($1, $3, '*');
 } |
 Expr '/' Expr {
-  $$ = gen_binop($1, $3, '/');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '/'));
 } |
 Expr '%' Expr {
-  $$ = gen_binop($1, $3, '%');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '%'));
 } |
 Expr "/=" Expr {
   $$ = gen_update($1, $3, '/');
@@ -395,22 +400,22 @@ Expr SETMOD Expr {
   $$ = gen_update($1, $3, '%');
 } |
 Expr "==" Expr {
-  $$ = gen_binop($1, $3, EQ);
+  $$ = gen_location(@$, locations, gen_binop($1, $3, EQ));
 } |
 Expr "!=" Expr {
-  $$ = gen_binop($1, $3, NEQ);
+  $$ = gen_location(@$, locations, gen_binop($1, $3, NEQ));
 } |
 Expr '<' Expr {
-  $$ = gen_binop($1, $3, '<');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '<'));
 } |
 Expr '>' Expr {
-  $$ = gen_binop($1, $3, '>');
+  $$ = gen_location(@$, locations, gen_binop($1, $3, '>'));
 } |
 Expr "<=" Expr {
-  $$ = gen_binop($1, $3, LESSEQ);
+  $$ = gen_location(@$, locations, gen_binop($1, $3, LESSEQ));
 } |
 Expr ">=" Expr {
-  $$ = gen_binop($1, $3, GREATEREQ);
+  $$ = gen_location(@$, locations, gen_binop($1, $3, GREATEREQ));
 } |
 Term %prec NONOPT {
   $$ = $1;
@@ -0,0 +1,664 @@
+/*
+ * Counting profiler behind --profile.
+ *
+ * The interpreter tells us which bytecode it is executing before every
+ * instruction.  Whenever that changes, the time since the previous
+ * change is charged as self time to the function that was running and
+ * as total time to every distinct function on its call chain.  Calls,
+ * instructions and backtracks are simply counted.  Time spent in C
+ * builtins is recorded per builtin, and is also part of the self time
+ * of the jq function that called it.
+ *
+ * Functions and builtins are identified by their struct bytecode or
+ * struct cfunction pointers, so the profile has to be reset whenever
+ * the program is replaced.
+ *
+ * With by_source set, the interpreter also says which instruction it's
+ * at, and time, instructions and allocations are charged to the source
+ * span that the compiler's location table gives for it.  That's reported
+ * as an annotated listing of each source file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+#include "jv_alloc.h"
+#include "util.h"
+
+struct prof_rec;
+
+struct prof_edge {
+  struct prof_rec *callee;
+  uint64_t calls;
+};
+
+struct prof_rec {
+  const void *key;   // struct bytecode or struct cfunction
+  int is_builtin;
+  uint64_t calls;
+  uint64_t instructions;
+  uint64_t backtracks;
+  double self;       // milliseconds
+  double total;
+  unsigned mark;     // for deduplicating recursive calls in the chain
+  struct prof_edge *callees;
+  int ncallees;
+  int *locations;    // pc, span index pairs; span -1 for no span
+  int nlocations;
+  int located;       // locations decoded from the debuginfo
+};
+
+struct prof_span {
+  int file;          // index into profile.files
+  int start;
+  int end;
+  uint64_t instructions;
+  uint64_t allocs;
+  double ms;
+};
+
+struct profile {
+  uint64_t ops[NUM_OPCODES];
+  uint64_t backtracks[NUM_OPCODES];
+
+  struct prof_rec **table;
+  size_t cap;
+  size_t count;
+
+  // The function currently running and its distinct callers
+  struct bytecode *bc;
+  struct prof_rec *cur;
+  struct prof_rec **chain;
+  int nchain;
+  int chain_cap;
+  unsigned mark;
+  double last;
+
+  // Source spans, and the one currently running
+  int by_source;
+  struct prof_span *spans;
+  int nspans;
+  int spans_cap;
+  jv files;          // names of the files the spans are in
+  jv sources;        // file name -> text, for files not read from disk
+  int span;
+  double span_last;
+  size_t span_allocs;
+  size_t own_allocs; // made by the profiler itself, so not charged
+};
+
+struct profile *profile_new(int by_source) {
+  struct profile *p = jv_mem_calloc(1, sizeof(struct profile));
+  p->cap = 64;
+  p->table = jv_mem_calloc(p->cap, sizeof(struct prof_rec *));
+  p->by_source = by_source;
+  p->files = jv_array();
+  p->sources = jv_object();
+  p->span = -1;
+  return p;
+}
+
+void profile_reset(struct profile *p) {
+  for (size_t i = 0; i < p->cap; i++) {
+    if (p->table[i]) {
+      jv_mem_free(p->table[i]->callees);
+      jv_mem_free(p->table[i]->locations);
+      jv_mem_free(p->table[i]);
+      p->table[i] = NULL;
+    }
+  }
+  p->count = 0;
+  memset(p->ops, 0, sizeof(p->ops));
+  memset(p->backtracks, 0, sizeof(p->backtracks));
+  p->bc = NULL;
+  p->cur = NULL;
+  p->nchain = 0;
+  p->nspans = 0;
+  jv_free(p->files);
+  jv_free(p->sources);
+  p->files = jv_array();
+  p->sources = jv_object();
+  p->span = -1;
+}
+
+void profile_free(struct profile *p) {
+  if (p == NULL)
+    return;
+  profile_reset(p);
+  jv_free(p->files);
+  jv_free(p->sources);
+  jv_mem_free(p->table);
+  jv_mem_free(p->chain);
+  jv_mem_free(p->spans);
+  jv_mem_free(p);
+}
+
+int profile_by_source(struct profile *p) {
+  return p->by_source;
+}
+
+// Gives the text of a file that can't be read back when reporting,
+// such as the main program.
+void profile_set_source(struct profile *p, const char *name, const char *text) {
+  p->sources = jv_object_set(p->sources, jv_string(name), jv_string(text));
+}
+
+static size_t slot(const void *key, size_t cap) {
+  return (size_t)(((uintptr_t)key >> 4) * 0x9e3779b97f4a7c15ull) & (cap - 1);
+}
+
+static struct prof_rec *lookup(struct profile *p, const void *key) {
+  size_t i = slot(key, p->cap);
+  while (p->table[i]) {
+    if (p->table[i]->key == key)
+      return p->table[i];
+    i = (i + 1) & (p->cap - 1);
+  }
+  p->own_allocs++;
+  if ((p->count + 1) * 2 > p->cap) {
+    p->own_allocs++;
+    struct prof_rec **old = p->table;
+    size_t oldcap = p->cap;
+    p->cap *= 2;
+    p->table = jv_mem_calloc(p->cap, sizeof(struct prof_rec *));
+    for (size_t j = 0; j < oldcap; j++) {
+      if (old[j] == NULL)
+        continue;
+      size_t k = slot(old[j]->key, p->cap);
+      while (p->table[k])
+        k = (k + 1) & (p->cap - 1);
+      p->table[k] = old[j];
+    }
+    jv_mem_free(old);
+    i = slot(key, p->cap);
+    while (p->table[i])
+      i = (i + 1) & (p->cap - 1);
+  }
+  struct prof_rec *r = jv_mem_calloc(1, sizeof(struct prof_rec));
+  r->key = key;
+  p->table[i] = r;
+  p->count++;
+  return r;
+}
+
+static void charge(struct profile *p) {
+  double now = jq_wall_ms();
+  double elapsed = now - p->last;
+  p->last = now;
+  if (p->cur)
+    p->cur->self += elapsed;
+  for (int i = 0; i < p->nchain; i++)
+    p->chain[i]->total += elapsed;
+}
+
+static void charge_span(struct profile *p) {
+  double now = jq_wall_ms();
+  size_t allocs = jv_mem_alloc_count() - p->own_allocs;
+  if (p->span >= 0) {
+    p->spans[p->span].ms += now - p->span_last;
+    p->spans[p->span].allocs += allocs - p->span_allocs;
+  }
+  p->span_last = now;
+  p->span_allocs = allocs;
+}
+
+void profile_resume(struct profile *p) {
+  p->bc = NULL;
+  p->cur = NULL;
+  p->nchain = 0;
+  p->last = jq_wall_ms();
+  p->span = -1;
+}
+
+void profile_pause(struct profile *p) {
+  charge(p);
+  if (p->by_source) {
+    charge_span(p);
+    p->span = -1;
+  }
+  p->bc = NULL;
+  p->cur = NULL;
+  p->nchain = 0;
+}
+
+// Returns 1 if bc isn't what was running, in which case the caller
+// must push the new call chain, starting with bc itself.
+int profile_switch(struct profile *p, struct bytecode *bc) {
+  if (bc == p->bc)
+    return 0;
+  charge(p);
+  p->bc = bc;
+  p->cur = lookup(p, bc);
+  p->nchain = 0;
+  p->mark++;
+  return 1;
+}
+
+void profile_chain_push(struct profile *p, struct bytecode *bc) {
+  struct prof_rec *r = lookup(p, bc);
+  if (r->mark == p->mark)
+    return;
+  r->mark = p->mark;
+  if (p->nchain == p->chain_cap) {
+    p->own_allocs++;
+    p->chain_cap = p->chain_cap ? p->chain_cap * 2 : 16;
+    p->chain = jv_mem_realloc(p->chain, p->chain_cap * sizeof(struct prof_rec *));
+  }
+  p->chain[p->nchain++] = r;
+}
+
+void profile_instruction(struct profile *p, uint16_t op, int backtracking) {
+  p->cur->instructions++;
+  if (backtracking) {
+    p->backtracks[op]++;
+    p->cur->backtracks++;
+  } else {
+    p->ops[op]++;
+  }
+}
+
+void profile_call(struct profile *p, struct bytecode *caller, struct bytecode *callee) {
+  struct prof_rec *callee_rec = lookup(p, callee);
+  struct prof_rec *caller_rec = lookup(p, caller);
+  callee_rec->calls++;
+  for (int i = 0; i < caller_rec->ncallees; i++) {
+    if (caller_rec->callees[i].callee == callee_rec) {
+      caller_rec->callees[i].calls++;
+      return;
+    }
+  }
+  // Grow by powers of two
+  int n = caller_rec->ncallees;
+  if ((n & (n - 1)) == 0) {
+    p->own_allocs++;
+    caller_rec->callees = jv_mem_realloc(caller_rec->callees,
+                                         (n ? n * 2 : 1) * sizeof(struct prof_edge));
+  }
+  caller_rec->callees[n].callee = callee_rec;
+  caller_rec->callees[n].calls = 1;
+  caller_rec->ncallees++;
+}
+
+static int span_index(struct profile *p, int file, int start, int end) {
+  for (int i = 0; i < p->nspans; i++) {
+    if (p->spans[i].file == file && p->spans[i].start == start && p->spans[i].end == end)
+      return i;
+  }
+  if (p->nspans == p->spans_cap) {
+    p->spans_cap = p->spans_cap ? p->spans_cap * 2 : 32;
+    p->spans = jv_mem_realloc(p->spans, p->spans_cap * sizeof(struct prof_span));
+  }
+  struct prof_span *span = &p->spans[p->nspans];
+  memset(span, 0, sizeof(*span));
+  span->file = file;
+  span->start = start;
+  span->end = end;
+  return p->nspans++;
+}
+
+static int file_index(struct profile *p, jv name) {
+  jv_array_foreach(p->files, i, f) {
+    if (jv_equal(f, jv_copy(name))) {
+      jv_free(name);
+      return i;
+    }
+  }
+  p->files = jv_array_append(p->files, name);
+  return jv_array_length(jv_copy(p->files)) - 1;
+}
+
+// Reads the [pc, start, end, ...] location table that the compiler
+// leaves in the debuginfo, skipping it if it's malformed.
+static void decode_locations(struct profile *p, struct prof_rec *r, struct bytecode *bc) {
+  size_t allocs = jv_mem_alloc_count();
+  r->located = 1;
+  jv file = jv_object_get(jv_copy(bc->debuginfo), jv_string("file"));
+  jv locations = jv_object_get(jv_copy(bc->debuginfo), jv_string("locations"));
+  int n = jv_get_kind(locations) == JV_KIND_ARRAY ? jv_array_length(jv_copy(locations)) : 0;
+  if (jv_get_kind(file) == JV_KIND_STRING && n > 0 && n % 3 == 0) {
+    int f = file_index(p, jv_copy(file));
+    r->locations = jv_mem_alloc(n / 3 * 2 * sizeof(int));
+    for (int i = 0; i < n / 3; i++) {
+      jv pc = jv_array_get(jv_copy(locations), i * 3);
+      jv start = jv_array_get(jv_copy(locations), i * 3 + 1);
+      jv end = jv_array_get(jv_copy(locations), i * 3 + 2);
+      int ok = jv_get_kind(pc) == JV_KIND_NUMBER &&
+        jv_get_kind(start) == JV_KIND_NUMBER && jv_get_kind(end) == JV_KIND_NUMBER &&
+        jv_number_value(pc) >= (i ? r->locations[i * 2 - 2] + 1 : 0) &&
+        jv_number_value(pc) < bc->codelen;
+      if (ok) {
+        r->locations[i * 2] = (int)jv_number_value(pc);
+        r->locations[i * 2 + 1] = jv_number_value(start) < 0 ? -1 :
+          span_index(p, f, (int)jv_number_value(start), (int)jv_number_value(end));
+      }
+      jv_free(pc);
+      jv_free(start);
+      jv_free(end);
+      if (!ok) {
+        jv_mem_free(r->locations);
+        r->locations = NULL;
+        break;
+      }
+      r->nlocations = i + 1;
+    }
+    if (r->locations == NULL)
+      r->nlocations = 0;
+  }
+  jv_free(file);
+  jv_free(locations);
+  p->own_allocs += jv_mem_alloc_count() - allocs;
+}
+
+// Charges the instruction at pc in bc to its source span.  Returns 0 if
+// it hasn't got one, so that the caller can try the code that called
+// bc.  With bc NULL, stops charging to any span.
+int profile_source(struct profile *p, struct bytecode *bc, int pc) {
+  int span = -1;
+  if (bc) {
+    struct prof_rec *r = bc == p->bc ? p->cur : lookup(p, bc);
+    if (!r->located)
+      decode_locations(p, r, bc);
+    // The last entry at or before pc
+    int lo = 0, hi = r->nlocations;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (r->locations[mid * 2] <= pc)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo == 0 || r->locations[lo * 2 - 1] < 0)
+      return 0;
+    span = r->locations[lo * 2 - 1];
+    p->spans[span].instructions++;
+  }
+  if (span != p->span) {
+    charge_span(p);
+    p->span = span;
+  }
+  return 1;
+}
+
+void profile_builtin(struct profile *p, const struct cfunction *cf, double elapsed) {
+  struct prof_rec *r = lookup(p, cf);
+  r->is_builtin = 1;
+  r->calls++;
+  r->self += elapsed;
+  r->total += elapsed;
+}
+
+// Functions are named name/arity after the function they're defined
+// in, and closures after their index as in --debug-dump-disasm.
+static jv function_name(struct bytecode *bc) {
+  if (bc->parent == NULL)
+    return jv_string("<top-level>");
+  jv name = jv_object_get(jv_copy(bc->debuginfo), jv_string("name"));
+  jv base;
+  if (jv_get_kind(name) != JV_KIND_STRING) {
+    base = jv_string("<unknown>");
+  } else if (strcmp(jv_string_value(name), "@lambda") == 0) {
+    int i = 0;
+    while (i < bc->parent->nsubfunctions && bc->parent->subfunctions[i] != bc)
+      i++;
+    base = jv_string_fmt("@lambda:%d", i);
+  } else {
+    base = jv_string_fmt("%s/%d", jv_string_value(name), bc->nclosures);
+  }
+  jv_free(name);
+  if (bc->parent->parent == NULL)
+    return base;
+  return jv_string_concat(jv_string_append_str(function_name(bc->parent), "."), base);
+}
+
+static jv rec_name(struct prof_rec *r) {
+  if (r->is_builtin) {
+    const struct cfunction *cf = r->key;
+    return jv_string_fmt("%s/%d", cf->name, cf->nargs - 1);
+  }
+  return function_name((struct bytecode *)r->key);
+}
+
+static jv opcode_counts(uint64_t *counts) {
+  jv ret = jv_object();
+  for (int i = 0; i < NUM_OPCODES; i++) {
+    if (counts[i])
+      ret = jv_object_set(ret, jv_string(opcode_describe(i)->name), jv_number(counts[i]));
+  }
+  return ret;
+}
+
+// Sorts an array of objects by descending numeric field
+static jv sort_desc(jv a, const char *field) {
+  jv keys = jv_array();
+  jv_array_foreach(a, i, x) {
+    jv v = jv_object_get(x, jv_string(field));
+    keys = jv_array_append(keys, jv_number(-jv_number_value(v)));
+    jv_free(v);
+  }
+  return jv_sort(a, keys);
+}
+
+// Charges each span to the line it starts on, and lists the spans
+// themselves, for one file of the program.
+static jv file_report(struct profile *p, int file, jv name) {
+  jv text = jv_object_get(jv_copy(p->sources), jv_copy(name));
+  if (jv_get_kind(text) != JV_KIND_STRING) {
+    jv_free(text);
+    text = jv_load_file(jv_string_value(name), 1);
+  }
+  jv lines = jv_array();
+  jv spans = jv_array();
+  if (jv_get_kind(text) == JV_KIND_STRING) {
+    const char *data = jv_string_value(text);
+    int length = jv_string_length_bytes(jv_copy(text));
+    int nlines = 1;
+    for (int i = 0; i < length; i++)
+      if (data[i] == '\n' && i + 1 < length)
+        nlines++;
+    int *starts = jv_mem_calloc(nlines + 1, sizeof(int));
+    struct prof_span *totals = jv_mem_calloc(nlines, sizeof(struct prof_span));
+    for (int i = 0, l = 1; i < length && l < nlines; i++)
+      if (data[i] == '\n')
+        starts[l++] = i + 1;
+    starts[nlines] = length + 1;
+
+    for (int i = 0; i < p->nspans; i++) {
+      struct prof_span *span = &p->spans[i];
+      if (span->file != file || span->start < 0 || span->start > span->end || span->end > length)
+        continue;
+      int line = 0;
+      while (starts[line + 1] <= span->start)
+        line++;
+      totals[line].instructions += span->instructions;
+      totals[line].allocs += span->allocs;
+      totals[line].ms += span->ms;
+      spans = jv_array_append(spans,
+                              JV_OBJECT(jv_string("line"), jv_number(line + 1),
+                                        jv_string("start"), jv_number(span->start),
+                                        jv_string("end"), jv_number(span->end),
+                                        jv_string("text"), jv_string_sized(data + span->start,
+                                                                           span->end - span->start),
+                                        jv_string("instructions"), jv_number(span->instructions),
+                                        jv_string("allocs"), jv_number(span->allocs),
+                                        jv_string("ms"), jv_number(span->ms)));
+    }
+    for (int l = 0; l < nlines; l++) {
+      int end = starts[l + 1] - 1;
+      if (end > starts[l] && data[end - 1] == '\n')
+        end--;
+      lines = jv_array_append(lines,
+                              JV_OBJECT(jv_string("line"), jv_number(l + 1),
+                                        jv_string("text"), jv_string_sized(data + starts[l], end - starts[l]),
+                                        jv_string("instructions"), jv_number(totals[l].instructions),
+                                        jv_string("allocs"), jv_number(totals[l].allocs),
+                                        jv_string("ms"), jv_number(totals[l].ms)));
+    }
+    jv_mem_free(starts);
+    jv_mem_free(totals);
+  }
+  jv_free(text);
+  return JV_OBJECT(jv_string("file"), name,
+                   jv_string("lines"), lines,
+                   jv_string("spans"), sort_desc(spans, "ms"));
+}
+
+jv profile_report(struct profile *p) {
+  uint64_t instructions = 0;
+  for (int i = 0; i < NUM_OPCODES; i++)
+    instructions += p->ops[i] + p->backtracks[i];
+
+  jv functions = jv_array();
+  jv builtins = jv_array();
+  for (size_t i = 0; i < p->cap; i++) {
+    struct prof_rec *r = p->table[i];
+    if (r == NULL)
+      continue;
+    if (r->is_builtin) {
+      builtins = jv_array_append(builtins,
+                                 JV_OBJECT(jv_string("name"), rec_name(r),
+                                           jv_string("calls"), jv_number(r->calls),
+                                           jv_string("total_ms"), jv_number(r->total)));
+      continue;
+    }
+    jv callees = jv_object();
+    for (int j = 0; j < r->ncallees; j++)
+      callees = jv_object_set(callees, rec_name(r->callees[j].callee),
+                              jv_number(r->callees[j].calls));
+    jv f = JV_OBJECT(jv_string("name"), rec_name(r),
+                     jv_string("calls"), jv_number(r->calls),
+                     jv_string("instructions"), jv_number(r->instructions),
+                     jv_string("backtracks"), jv_number(r->backtracks),
+                     jv_string("self_ms"), jv_number(r->self),
+                     jv_string("total_ms"), jv_number(r->total));
+    functions = jv_array_append(functions, jv_object_set(f, jv_string("callees"), callees));
+  }
+
+  jv report = JV_OBJECT(jv_string("instructions"), jv_number(instructions),
+                        jv_string("opcodes"), opcode_counts(p->ops),
+                        jv_string("backtracks"), opcode_counts(p->backtracks),
+                        jv_string("functions"), sort_desc(functions, "self_ms"),
+                        jv_string("builtins"), sort_desc(builtins, "total_ms"));
+  if (p->by_source) {
+    jv sources = jv_array();
+    jv_array_foreach(p->files, i, name)
+      sources = jv_array_append(sources, file_report(p, i, name));
+    report = jv_object_set(report, jv_string("sources"), sources);
+  }
+  return report;
+}
+
+static double field(jv o, const char *name) {
+  jv v = jv_object_get(jv_copy(o), jv_string(name));
+  double d = jv_get_kind(v) == JV_KIND_NUMBER ? jv_number_value(v) : 0;
+  jv_free(v);
+  return d;
+}
+
+// Prints one line of a source listing, or just the source if nothing
+// was charged to it
+static void dump_source_line(FILE *f, jv o, int is_span) {
+  jv text = jv_object_get(jv_copy(o), jv_string("text"));
+  if (field(o, "instructions"))
+    fprintf(f, "%10.3f %10.0f %12.0f", field(o, "ms"), field(o, "allocs"), field(o, "instructions"));
+  else
+    fprintf(f, "%10s %10s %12s", "", "", "");
+  if (!is_span) {
+    fprintf(f, " %5.0f | %s\n", field(o, "line"), jv_string_value(text));
+  } else {
+    // Spans may cover several lines
+    fprintf(f, " %5.0f | ", field(o, "line"));
+    for (const char *c = jv_string_value(text); *c; c++)
+      fputc(*c == '\n' || *c == '\t' ? ' ' : *c, f);
+    fputc('\n', f);
+  }
+  jv_free(text);
+  jv_free(o);
+}
+
+static void dump_source(jv source, FILE *f) {
+  jv name = jv_object_get(jv_copy(source), jv_string("file"));
+  jv lines = jv_object_get(jv_copy(source), jv_string("lines"));
+  jv spans = jv_object_get(jv_copy(source), jv_string("spans"));
+  fprintf(f, "\njq: source profile of %s\n", jv_string_value(name));
+  fprintf(f, "%10s %10s %12s %5s |\n", "ms", "allocs", "instructions", "line");
+  jv_array_foreach(lines, i, line)
+    dump_source_line(f, line, 0);
+  fprintf(f, "\n%10s %10s %12s %5s | %s\n", "ms", "allocs", "instructions", "line", "span");
+  jv_array_foreach(spans, i, span) {
+    if (i == 10) {
+      jv_free(span);
+      break;
+    }
+    dump_source_line(f, span, 1);
+  }
+  jv_free(name);
+  jv_free(lines);
+  jv_free(spans);
+  jv_free(source);
+}
+
+// Prints a report made by profile_report()
+void profile_dump(jv report, FILE *f) {
+  jv functions = jv_object_get(jv_copy(report), jv_string("functions"));
+  jv builtins = jv_object_get(jv_copy(report), jv_string("builtins"));
+
+  fprintf(f, "jq: profile: %.0f instructions\n\n", field(report, "instructions"));
+  fprintf(f, "%10s %10s %10s %12s %10s  %s\n",
+          "self ms", "total ms", "calls", "instructions", "backtracks", "function");
+  jv_array_foreach(functions, i, fn) {
+    jv name = jv_object_get(jv_copy(fn), jv_string("name"));
+    fprintf(f, "%10.3f %10.3f %10.0f %12.0f %10.0f  %s\n",
+            field(fn, "self_ms"), field(fn, "total_ms"), field(fn, "calls"),
+            field(fn, "instructions"), field(fn, "backtracks"), jv_string_value(name));
+    jv_free(name);
+    jv_free(fn);
+  }
+
+  fprintf(f, "\n%10s  %s\n", "calls", "call graph");
+  jv_array_foreach(functions, i, fn) {
+    jv callees = jv_object_get(jv_copy(fn), jv_string("callees"));
+    if (jv_object_length(jv_copy(callees)) > 0) {
+      jv caller = jv_object_get(jv_copy(fn), jv_string("name"));
+      fprintf(f, "%10s  %s\n", "", jv_string_value(caller));
+      jv_free(caller);
+      jv_object_foreach(callees, name, calls) {
+        fprintf(f, "%10.0f    -> %s\n", jv_number_value(calls), jv_string_value(name));
+        jv_free(name);
+        jv_free(calls);
+      }
+    }
+    jv_free(callees);
+    jv_free(fn);
+  }
+
+  fprintf(f, "\n%10s %10s  %s\n", "total ms", "calls", "builtin");
+  jv_array_foreach(builtins, i, b) {
+    jv name = jv_object_get(jv_copy(b), jv_string("name"));
+    fprintf(f, "%10.3f %10.0f  %s\n",
+            field(b, "total_ms"), field(b, "calls"), jv_string_value(name));
+    jv_free(name);
+    jv_free(b);
+  }
+
+  jv ops = jv_object_get(jv_copy(report), jv_string("opcodes"));
+  jv backtracks = jv_object_get(jv_copy(report), jv_string("backtracks"));
+  fprintf(f, "\n%12s %12s  %s\n", "executed", "backtracked", "opcode");
+  for (int i = 0; i < NUM_OPCODES; i++) {
+    const char *name = opcode_describe(i)->name;
+    double n = field(ops, name), b = field(backtracks, name);
+    if (n || b)
+      fprintf(f, "%12.0f %12.0f  %s\n", n, b, name);
+  }
+  jv_free(ops);
+  jv_free(backtracks);
+  jv_free(functions);
+  jv_free(builtins);
+
+  jv sources = jv_object_get(jv_copy(report), jv_string("sources"));
+  if (jv_get_kind(sources) == JV_KIND_ARRAY)
+    jv_array_foreach(sources, i, source)
+      dump_source(source, f);
+  jv_free(sources);
+  jv_free(report);
+}
@@ -0,0 +1,26 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "bytecode.h"
+
+struct profile;
+
+struct profile *profile_new(int);
+void profile_free(struct profile *);
+void profile_reset(struct profile *);
+int profile_by_source(struct profile *);
+void profile_set_source(struct profile *, const char *, const char *);
+
+void profile_resume(struct profile *);
+void profile_pause(struct profile *);
+int profile_switch(struct profile *, struct bytecode *);
+void profile_chain_push(struct profile *, struct bytecode *);
+void profile_instruction(struct profile *, uint16_t, int);
+void profile_call(struct profile *, struct bytecode *, struct bytecode *);
+int profile_source(struct profile *, struct bytecode *, int);
+void profile_builtin(struct profile *, const struct cfunction *, double);
+
+jv profile_report(struct profile *);
+void profile_dump(jv, FILE *);
+
+#endif
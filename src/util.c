@@ -29,6 +29,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef HAVE_GETTIMEOFDAY
+#include <sys/time.h>
+#endif
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -160,25 +163,65 @@ const void *_jq_memmem(const void *haystack, size_t haystacklen,
 #else
   const char *h = haystack;
   const char *n = needle;
-  size_t hi, hi2, ni;
+  const char *last;
 
   if (haystacklen < needlelen || haystacklen == 0)
     return NULL;
-  for (hi = 0; hi < (haystacklen - needlelen + 1); hi++) {
-    for (ni = 0, hi2 = hi; ni < needlelen; ni++, hi2++) {
-      if (h[hi2] != n[ni])
-        goto not_this;
-    }
-
-    return &h[hi];
-
-not_this:
-    continue;
+  if (needlelen == 0)
+    return h;
+  last = h + (haystacklen - needlelen);
+  // Skip to candidates with memchr(), which libcs make fast, and only
+  // then compare the rest of the needle
+  for (const char *p = h; (p = memchr(p, n[0], last - p + 1)) != NULL; p++) {
+    if (memcmp(p + 1, n + 1, needlelen - 1) == 0)
+      return p;
   }
   return NULL;
 #endif /* !HAVE_MEMMEM */
 }
 
+double jq_wall_ms(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+#ifdef HAVE_GETTIMEOFDAY
+  struct timeval tv;
+  if (gettimeofday(&tv, NULL) == 0)
+    return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+#endif
+  return time(NULL) * 1e3;
+}
+
+// CPU time of the calling thread where the platform has it, else of
+// the process
+double jq_cpu_ms(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+  return clock() * 1e3 / CLOCKS_PER_SEC;
+}
+
+void jq_timer_start(struct jq_timer *t) {
+  t->wall = jq_wall_ms();
+  t->cpu = clock() * 1e3 / CLOCKS_PER_SEC;
+  t->allocs = jv_mem_alloc_count();
+}
+
+void jq_timer_lap(struct jq_timer *t, const char *phase) {
+  if (t == NULL)
+    return;
+  struct jq_timer now;
+  jq_timer_start(&now);
+  fprintf(stderr, "jq: timing: %-14s %9.3f ms wall %9.3f ms cpu %8lu allocs\n",
+          phase, now.wall - t->wall, now.cpu - t->cpu,
+          (unsigned long)(now.allocs - t->allocs));
+  *t = now;
+}
+
 struct jq_util_input_state {
   jq_util_msg_cb err_cb;
   void *err_cb_data;
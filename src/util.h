@@ -44,6 +44,23 @@ static void priv_fwrite(const char *s, size_t len, FILE *fout, int is_tty) {
 const void *_jq_memmem(const void *haystack, size_t haystacklen,
                        const void *needle, size_t needlelen);
 
+/*
+ * Phase timer for --debug-timings.  jq_timer_lap() prints the wall and
+ * CPU time and the number of allocations since the previous lap (or
+ * jq_timer_start()) to stderr.  It does nothing given NULL, so callers
+ * can pass a NULL timer when timings are off.
+ */
+struct jq_timer {
+  double wall;
+  double cpu;
+  size_t allocs;
+};
+
+double jq_wall_ms(void);
+double jq_cpu_ms(void);
+void jq_timer_start(struct jq_timer *);
+void jq_timer_lap(struct jq_timer *, const char *);
+
 #ifndef MIN
 #define MIN(a,b) \
   ({ __typeof__ (a) _a = (a); \